@@ -0,0 +1,497 @@
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "chip8.h"
+
+#define MAX_THREADS 64
+
+typedef struct VecEnv_t VecEnv;
+typedef struct Worker_t Worker;
+
+struct Worker_t
+{
+    VecEnv *env;
+    int index;
+    pthread_t thread;
+};
+
+/*
+ * A batch of machines running one ROM. Every call into C steps the whole
+ * batch a frame, so the interpreter is crossed once per frame, not per
+ * instruction. The machines sit in one array, which lets the frames be
+ * exposed as a single strided (N, 32, 64) buffer without copying.
+ */
+struct VecEnv_t
+{
+    PyObject_HEAD
+    Chip8 *machines;
+    Chip8Image *image;
+    int num_envs;
+    uint32_t seed;
+
+    uint16_t *actions;
+    uint8_t *statuses;
+    bool busy;
+
+    // Worker threads wait for the generation to change, then step their share
+    int num_threads;
+    Worker workers[MAX_THREADS];
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    unsigned int generation;
+    int remaining;
+    bool stopping;
+};
+
+static void reset_env(VecEnv *env, int index)
+{
+    Chip8 *chip8 = &env->machines[index];
+    chip8_release(chip8);
+    chip8_init(chip8);
+    chip8_attach_image(chip8, env->image);
+    chip8_seed(chip8, env->seed + index);
+    env->statuses[index] = CHIP8_OK;
+}
+
+/*
+ * Run one frame on every machine in a worker's share of the batch
+ */
+static void step_share(VecEnv *env, int worker)
+{
+    int begin = (long)env->num_envs * worker / env->num_threads;
+    int end = (long)env->num_envs * (worker + 1) / env->num_threads;
+
+    for (int i = begin; i < end; i++)
+    {
+        Chip8 *chip8 = &env->machines[i];
+        for (int k = 0; k < NUM_KEYS; k++)
+        {
+            chip8->keypad[k] = (env->actions[i] >> k) & 1;
+        }
+
+        env->statuses[i] = chip8_run(chip8, chip8->cycles_per_frame, CHIP8_STOP_ON(CHIP8_FRAME));
+    }
+}
+
+static void *worker_main(void *arg)
+{
+    Worker *worker = arg;
+    VecEnv *env = worker->env;
+    unsigned int generation = 0;
+
+    pthread_mutex_lock(&env->lock);
+    while (true)
+    {
+        while (env->generation == generation && !env->stopping)
+            pthread_cond_wait(&env->start, &env->lock);
+        if (env->stopping)
+            break;
+        generation = env->generation;
+        pthread_mutex_unlock(&env->lock);
+
+        step_share(env, worker->index);
+
+        pthread_mutex_lock(&env->lock);
+        if (--env->remaining == 0)
+            pthread_cond_signal(&env->done);
+    }
+    pthread_mutex_unlock(&env->lock);
+
+    return NULL;
+}
+
+/*
+ * Step the whole batch, with the calling thread taking the first share
+ */
+static void step_all(VecEnv *env)
+{
+    if (env->num_threads == 1)
+    {
+        step_share(env, 0);
+        return;
+    }
+
+    pthread_mutex_lock(&env->lock);
+    env->remaining = env->num_threads - 1;
+    env->generation++;
+    pthread_cond_broadcast(&env->start);
+    pthread_mutex_unlock(&env->lock);
+
+    step_share(env, 0);
+
+    pthread_mutex_lock(&env->lock);
+    while (env->remaining > 0)
+        pthread_cond_wait(&env->done, &env->lock);
+    pthread_mutex_unlock(&env->lock);
+}
+
+static void stop_workers(VecEnv *env)
+{
+    pthread_mutex_lock(&env->lock);
+    env->stopping = true;
+    pthread_cond_broadcast(&env->start);
+    pthread_mutex_unlock(&env->lock);
+
+    for (int w = 1; w < env->num_threads; w++)
+    {
+        pthread_join(env->workers[w].thread, NULL);
+    }
+}
+
+static void VecEnv_dealloc(VecEnv *env)
+{
+    if (env->num_threads > 1)
+        stop_workers(env);
+    pthread_mutex_destroy(&env->lock);
+    pthread_cond_destroy(&env->start);
+    pthread_cond_destroy(&env->done);
+
+    if (env->machines != NULL)
+    {
+        for (int i = 0; i < env->num_envs; i++)
+        {
+            chip8_release(&env->machines[i]);
+        }
+    }
+
+    free(env->machines);
+    free(env->image);
+    PyMem_Free(env->actions);
+    PyMem_Free(env->statuses);
+    Py_TYPE(env)->tp_free((PyObject *)env);
+}
+
+static PyObject *VecEnv_new(PyTypeObject *type, PyObject *args, PyObject *kwargs)
+{
+    VecEnv *env = (VecEnv *)type->tp_alloc(type, 0);
+    if (env == NULL)
+        return NULL;
+
+    // The threads only exist once __init__ succeeds
+    env->num_threads = 1;
+    pthread_mutex_init(&env->lock, NULL);
+    pthread_cond_init(&env->start, NULL);
+    pthread_cond_init(&env->done, NULL);
+    return (PyObject *)env;
+}
+
+static int VecEnv_init(VecEnv *env, PyObject *args, PyObject *kwargs)
+{
+    static char *keywords[] = {"rom", "num_envs", "threads", "seed", NULL};
+    const char *rom_filename;
+    int num_envs;
+    int num_threads = 1;
+    unsigned int seed = 1;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "si|iI", keywords, &rom_filename, &num_envs,
+                                     &num_threads, &seed))
+        return -1;
+
+    if (env->image != NULL)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "VecEnv is already initialized");
+        return -1;
+    }
+    if (num_envs < 1)
+    {
+        PyErr_SetString(PyExc_ValueError, "num_envs must be positive");
+        return -1;
+    }
+    if (num_threads < 1 || num_threads > MAX_THREADS)
+    {
+        PyErr_Format(PyExc_ValueError, "threads must be between 1 and %d", MAX_THREADS);
+        return -1;
+    }
+
+    env->image = aligned_alloc(_Alignof(Chip8Image), sizeof(Chip8Image));
+    env->machines = aligned_alloc(_Alignof(Chip8), sizeof(Chip8) * num_envs);
+    env->actions = PyMem_Calloc(num_envs, sizeof(uint16_t));
+    env->statuses = PyMem_Calloc(num_envs, sizeof(uint8_t));
+    if (env->image == NULL || env->machines == NULL || env->actions == NULL || env->statuses == NULL)
+    {
+        PyErr_NoMemory();
+        return -1;
+    }
+
+    chip8_image_init(env->image);
+    if (!chip8_image_load_rom(env->image, rom_filename))
+    {
+        PyErr_Format(PyExc_OSError, "Failed to load ROM %s", rom_filename);
+        free(env->machines);
+        env->machines = NULL;
+        return -1;
+    }
+
+    // Every machine shares the ROM's pages until it writes to them
+    env->num_envs = num_envs;
+    env->seed = seed;
+    for (int i = 0; i < num_envs; i++)
+    {
+        chip8_init(&env->machines[i]);
+        reset_env(env, i);
+    }
+
+    // Never start more threads than there are machines to step
+    if (num_threads > num_envs)
+        num_threads = num_envs;
+
+    for (int w = 1; w < num_threads; w++)
+    {
+        env->workers[w].env = env;
+        env->workers[w].index = w;
+        if (pthread_create(&env->workers[w].thread, NULL, worker_main, &env->workers[w]) != 0)
+        {
+            env->num_threads = w;
+            PyErr_SetString(PyExc_RuntimeError, "Failed to start worker threads");
+            return -1;
+        }
+    }
+    env->num_threads = num_threads;
+
+    return 0;
+}
+
+static bool check_ready(VecEnv *env)
+{
+    if (env->machines == NULL)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "VecEnv is not initialized");
+        return false;
+    }
+    if (env->busy)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "VecEnv is being stepped by another thread");
+        return false;
+    }
+    return true;
+}
+
+/*
+ * Copy the actions into the key masks. A C-contiguous uint16 buffer, such as
+ * a NumPy array, is copied directly; any other sequence goes element by element.
+ */
+static bool read_actions(VecEnv *env, PyObject *actions)
+{
+    Py_buffer view;
+    if (PyObject_GetBuffer(actions, &view, PyBUF_FORMAT | PyBUF_C_CONTIGUOUS) == 0)
+    {
+        bool matches = view.itemsize == sizeof(uint16_t) && view.format != NULL &&
+                       strcmp(view.format, "H") == 0 &&
+                       view.len == (Py_ssize_t)(env->num_envs * sizeof(uint16_t));
+        if (matches)
+            memcpy(env->actions, view.buf, view.len);
+        PyBuffer_Release(&view);
+        if (matches)
+            return true;
+    }
+    PyErr_Clear();
+
+    PyObject *sequence = PySequence_Fast(actions, "actions must be a sequence of key masks");
+    if (sequence == NULL)
+        return false;
+
+    if (PySequence_Fast_GET_SIZE(sequence) != env->num_envs)
+    {
+        PyErr_Format(PyExc_ValueError, "expected %d actions", env->num_envs);
+        Py_DECREF(sequence);
+        return false;
+    }
+
+    PyObject **items = PySequence_Fast_ITEMS(sequence);
+    for (int i = 0; i < env->num_envs; i++)
+    {
+        unsigned long keys = PyLong_AsUnsignedLong(items[i]);
+        if (keys == (unsigned long)-1 && PyErr_Occurred())
+        {
+            Py_DECREF(sequence);
+            return false;
+        }
+        env->actions[i] = keys & 0xFFFF;
+    }
+
+    Py_DECREF(sequence);
+    return true;
+}
+
+static PyObject *VecEnv_step(VecEnv *env, PyObject *actions)
+{
+    if (!check_ready(env) || !read_actions(env, actions))
+        return NULL;
+
+    // Other Python threads may run meanwhile, but not step this batch
+    env->busy = true;
+    Py_BEGIN_ALLOW_THREADS
+    step_all(env);
+    Py_END_ALLOW_THREADS
+    env->busy = false;
+
+    return PyBytes_FromStringAndSize((const char *)env->statuses, env->num_envs);
+}
+
+static PyObject *VecEnv_reset(VecEnv *env, PyObject *args)
+{
+    int index = -1;
+    if (!PyArg_ParseTuple(args, "|i", &index) || !check_ready(env))
+        return NULL;
+
+    if (index >= env->num_envs)
+    {
+        PyErr_SetString(PyExc_IndexError, "environment index out of range");
+        return NULL;
+    }
+
+    if (index >= 0)
+    {
+        reset_env(env, index);
+        Py_RETURN_NONE;
+    }
+
+    for (int i = 0; i < env->num_envs; i++)
+    {
+        reset_env(env, i);
+    }
+    Py_RETURN_NONE;
+}
+
+/*
+ * Expose the framebuffers as a read-only (num_envs, 32, 64) uint32 buffer.
+ * It is a view into the machines, strided by sizeof(Chip8), so it always
+ * shows the latest frame.
+ */
+static int VecEnv_getbuffer(VecEnv *env, Py_buffer *view, int flags)
+{
+    if (env->machines == NULL)
+    {
+        PyErr_SetString(PyExc_BufferError, "VecEnv is not initialized");
+        return -1;
+    }
+    if ((flags & PyBUF_WRITABLE) == PyBUF_WRITABLE)
+    {
+        PyErr_SetString(PyExc_BufferError, "frames are read-only");
+        return -1;
+    }
+    if ((flags & PyBUF_STRIDES) != PyBUF_STRIDES)
+    {
+        PyErr_SetString(PyExc_BufferError, "frames are strided and need a strided view");
+        return -1;
+    }
+
+    static Py_ssize_t shape_template[3] = {0, SCREEN_HEIGHT, SCREEN_WIDTH};
+    static Py_ssize_t strides[3] = {sizeof(Chip8), SCREEN_WIDTH * sizeof(uint32_t), sizeof(uint32_t)};
+    Py_ssize_t *shape = PyMem_Malloc(sizeof(shape_template));
+    if (shape == NULL)
+    {
+        PyErr_NoMemory();
+        return -1;
+    }
+    memcpy(shape, shape_template, sizeof(shape_template));
+    shape[0] = env->num_envs;
+
+    view->buf = env->machines[0].screen;
+    view->obj = (PyObject *)env;
+    Py_INCREF(env);
+    view->len = (Py_ssize_t)env->num_envs * sizeof(env->machines[0].screen);
+    view->readonly = 1;
+    view->itemsize = sizeof(uint32_t);
+    view->format = (flags & PyBUF_FORMAT) ? "I" : NULL;
+    view->ndim = 3;
+    view->shape = shape;
+    view->strides = strides;
+    view->suboffsets = NULL;
+    view->internal = shape;
+    return 0;
+}
+
+static void VecEnv_releasebuffer(VecEnv *env, Py_buffer *view)
+{
+    PyMem_Free(view->internal);
+}
+
+static PyObject *VecEnv_get_frames(VecEnv *env, void *closure)
+{
+    return PyMemoryView_FromObject((PyObject *)env);
+}
+
+static PyObject *VecEnv_get_num_envs(VecEnv *env, void *closure)
+{
+    return PyLong_FromLong(env->num_envs);
+}
+
+static PyMethodDef VecEnv_methods[] = {
+    {"step", (PyCFunction)VecEnv_step, METH_O,
+     "step(actions) -> bytes\n\nRun every machine for one frame, holding the key mask in "
+     "actions[i] on machine i. Returns each machine's Chip8Status."},
+    {"reset", (PyCFunction)VecEnv_reset, METH_VARARGS,
+     "reset(index=-1)\n\nRestart one machine, or every machine if no index is given."},
+    {NULL},
+};
+
+static PyGetSetDef VecEnv_getset[] = {
+    {"frames", (getter)VecEnv_get_frames, NULL,
+     "Live (num_envs, 32, 64) uint32 view of the screens; lit pixels are nonzero.", NULL},
+    {"num_envs", (getter)VecEnv_get_num_envs, NULL, "Number of machines in the batch.", NULL},
+    {NULL},
+};
+
+static PyBufferProcs VecEnv_as_buffer = {
+    (getbufferproc)VecEnv_getbuffer,
+    (releasebufferproc)VecEnv_releasebuffer,
+};
+
+static PyTypeObject VecEnvType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "chip8.VecEnv",
+    .tp_doc = "VecEnv(rom, num_envs, threads=1, seed=1)\n\n"
+              "A batch of machines running one ROM, stepped a frame at a time.",
+    .tp_basicsize = sizeof(VecEnv),
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_new = VecEnv_new,
+    .tp_init = (initproc)VecEnv_init,
+    .tp_dealloc = (destructor)VecEnv_dealloc,
+    .tp_methods = VecEnv_methods,
+    .tp_getset = VecEnv_getset,
+    .tp_as_buffer = &VecEnv_as_buffer,
+};
+
+static struct PyModuleDef chip8_module = {
+    PyModuleDef_HEAD_INIT,
+    .m_name = "chip8",
+    .m_doc = "Batched CHIP-8 emulation",
+    .m_size = -1,
+};
+
+PyMODINIT_FUNC PyInit_chip8(void)
+{
+    if (PyType_Ready(&VecEnvType) < 0)
+        return NULL;
+
+    PyObject *module = PyModule_Create(&chip8_module);
+    if (module == NULL)
+        return NULL;
+
+    Py_INCREF(&VecEnvType);
+    if (PyModule_AddObject(module, "VecEnv", (PyObject *)&VecEnvType) < 0)
+    {
+        Py_DECREF(&VecEnvType);
+        Py_DECREF(module);
+        return NULL;
+    }
+
+    // Status codes returned by step; anything from ILLEGAL_OPCODE up is a fault
+    PyModule_AddIntConstant(module, "OK", CHIP8_OK);
+    PyModule_AddIntConstant(module, "DRAW", CHIP8_DRAW);
+    PyModule_AddIntConstant(module, "FRAME", CHIP8_FRAME);
+    PyModule_AddIntConstant(module, "KEY_WAIT", CHIP8_KEY_WAIT);
+    PyModule_AddIntConstant(module, "BREAKPOINT", CHIP8_BREAKPOINT);
+    PyModule_AddIntConstant(module, "ILLEGAL_OPCODE", CHIP8_ILLEGAL_OPCODE);
+    PyModule_AddIntConstant(module, "STACK_OVERFLOW", CHIP8_STACK_OVERFLOW);
+    PyModule_AddIntConstant(module, "STACK_UNDERFLOW", CHIP8_STACK_UNDERFLOW);
+    PyModule_AddIntConstant(module, "OUT_OF_MEMORY", CHIP8_OUT_OF_MEMORY);
+
+    return module;
+}
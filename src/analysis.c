@@ -0,0 +1,207 @@
+#include "analysis.h"
+#include "disassembler.h"
+
+#include <string.h>
+
+static uint16_t fetch(const uint8_t *memory, uint16_t address)
+{
+    return (memory[address & RAM_MASK] << 8) | memory[(address + 1) & RAM_MASK];
+}
+
+/*
+ * Check whether [start, start + length) overlaps any reachable instruction byte
+ */
+static bool overlaps_code(const Analysis *analysis, uint16_t start, unsigned int length)
+{
+    for (unsigned int i = 0; i < length; i++)
+    {
+        if (analysis->flags[(start + i) & RAM_MASK] & (ANALYSIS_CODE | ANALYSIS_OPERAND))
+            return true;
+    }
+
+    return false;
+}
+
+/*
+ * Follow every control flow edge from START_ADDRESS and mark reachable instructions
+ */
+static void trace_code(Analysis *analysis, const uint8_t *memory)
+{
+    // Only visited instructions push, at most two addresses each
+    uint16_t worklist[2 * TOTAL_RAM + 1];
+    int top = 0;
+
+    worklist[top++] = START_ADDRESS;
+    analysis->flags[START_ADDRESS] |= ANALYSIS_JUMP_TARGET;
+
+    while (top > 0)
+    {
+        uint16_t address = worklist[--top];
+        if (analysis->flags[address] & ANALYSIS_CODE)
+            continue;
+
+        uint16_t opcode = fetch(memory, address);
+        if (!chip8_is_valid_opcode(opcode))
+        {
+            analysis->num_illegal++;
+            continue;
+        }
+
+        uint16_t next = (address + 2) & RAM_MASK;
+        uint16_t skip = (address + 4) & RAM_MASK;
+        uint16_t nnn = opcode & 0x0FFF;
+
+        analysis->flags[address] |= ANALYSIS_CODE;
+        analysis->flags[(address + 1) & RAM_MASK] |= ANALYSIS_OPERAND;
+        analysis->num_instructions++;
+
+        switch (opcode & 0xF000)
+        {
+        case 0x0000:
+            // RET ends the path; CLS falls through
+            if (opcode == 0x00E0)
+                worklist[top++] = next;
+            break;
+
+        case 0x1000:
+            analysis->flags[nnn] |= ANALYSIS_JUMP_TARGET;
+            worklist[top++] = nnn;
+            break;
+
+        case 0x2000:
+            // The subroutine returns to the next instruction
+            analysis->flags[nnn] |= ANALYSIS_CALL_TARGET;
+            analysis->flags[next] |= ANALYSIS_JUMP_TARGET;
+            worklist[top++] = nnn;
+            worklist[top++] = next;
+            break;
+
+        case 0x3000:
+        case 0x4000:
+        case 0x5000:
+        case 0x9000:
+        case 0xE000:
+            analysis->flags[skip] |= ANALYSIS_JUMP_TARGET;
+            worklist[top++] = next;
+            worklist[top++] = skip;
+            break;
+
+        case 0xA000:
+            analysis->flags[nnn] |= ANALYSIS_DATA;
+            worklist[top++] = next;
+            break;
+
+        case 0xB000:
+            // The target depends on V0, so only the base is followed
+            analysis->flags[address] |= ANALYSIS_INDIRECT_JUMP;
+            analysis->flags[nnn] |= ANALYSIS_JUMP_TARGET;
+            analysis->num_indirect_jumps++;
+            worklist[top++] = nnn;
+            break;
+
+        default:
+            worklist[top++] = next;
+            break;
+        }
+    }
+}
+
+/*
+ * Mark loops that cannot make progress until the delay timer expires:
+ * a jump to itself, or LD Vx, DT; SE/SNE Vx, kk; JP back to the load
+ */
+static void find_idle_loops(Analysis *analysis, const uint8_t *memory)
+{
+    for (unsigned int address = 0; address < TOTAL_RAM; address++)
+    {
+        if (!(analysis->flags[address] & ANALYSIS_CODE))
+            continue;
+
+        uint16_t opcode = fetch(memory, address);
+        bool idle = opcode == (0x1000 | address);
+
+        if ((opcode & 0xF0FF) == 0xF007)
+        {
+            uint16_t test = fetch(memory, address + 2);
+            uint16_t jump = fetch(memory, address + 4);
+            bool same_register = (test & 0x0F00) == (opcode & 0x0F00);
+
+            idle = same_register &&
+                   ((test & 0xF000) == 0x3000 || (test & 0xF000) == 0x4000) &&
+                   jump == (0x1000 | address);
+        }
+
+        if (idle)
+        {
+            analysis->flags[address] |= ANALYSIS_IDLE_LOOP;
+            analysis->num_idle_loops++;
+        }
+    }
+}
+
+/*
+ * Track I through straight-line code and flag FX33/FX55 stores into code.
+ * I is forgotten at every jump target, after calls and on any other write to I.
+ */
+static void find_stores(Analysis *analysis, const uint8_t *memory)
+{
+    int known_i = -1;
+    unsigned int previous = TOTAL_RAM;
+
+    for (unsigned int address = 0; address < TOTAL_RAM; address++)
+    {
+        uint8_t flags = analysis->flags[address];
+        if (!(flags & ANALYSIS_CODE))
+            continue;
+
+        if (address != previous + 2 || (flags & (ANALYSIS_JUMP_TARGET | ANALYSIS_CALL_TARGET)))
+            known_i = -1;
+        previous = address;
+
+        uint16_t opcode = fetch(memory, address);
+        unsigned int x = (opcode & 0x0F00) >> 8;
+        unsigned int length = 0;
+
+        if ((opcode & 0xF000) == 0xA000)
+        {
+            known_i = opcode & 0x0FFF;
+            continue;
+        }
+
+        if ((opcode & 0xF000) == 0x2000 || (opcode & 0xF0FF) == 0xF01E || (opcode & 0xF0FF) == 0xF029)
+        {
+            known_i = -1;
+            continue;
+        }
+
+        if ((opcode & 0xF0FF) == 0xF033)
+            length = 3;
+        else if ((opcode & 0xF0FF) == 0xF055)
+            length = x + 1;
+        else
+            continue;
+
+        if (known_i < 0)
+        {
+            analysis->num_unknown_stores++;
+        }
+        else if (overlaps_code(analysis, known_i, length))
+        {
+            analysis->flags[address] |= ANALYSIS_SELF_MODIFY;
+            analysis->num_self_modifying++;
+        }
+    }
+}
+
+/*
+ * Build a control flow graph of the program in memory and classify every byte
+ */
+void chip8_analyze(Analysis *analysis, const uint8_t *memory, uint16_t rom_size)
+{
+    memset(analysis, 0, sizeof(*analysis));
+    analysis->rom_end = START_ADDRESS + rom_size;
+
+    trace_code(analysis, memory);
+    find_idle_loops(analysis, memory);
+    find_stores(analysis, memory);
+}
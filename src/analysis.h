@@ -0,0 +1,33 @@
+#ifndef ANALYSIS_H
+#define ANALYSIS_H
+
+#include "chip8.h"
+
+// Per-byte flags produced by chip8_analyze
+#define ANALYSIS_CODE 0x01          // First byte of a reachable instruction
+#define ANALYSIS_OPERAND 0x02       // Second byte of a reachable instruction
+#define ANALYSIS_JUMP_TARGET 0x04   // Target of JP, a skip or a return address
+#define ANALYSIS_CALL_TARGET 0x08   // Entry point of a subroutine
+#define ANALYSIS_DATA 0x10          // Loaded into I by LD I, addr
+#define ANALYSIS_IDLE_LOOP 0x20     // Start of a loop that only polls DT or jumps to itself
+#define ANALYSIS_SELF_MODIFY 0x40   // FX33/FX55 whose target overlaps code
+#define ANALYSIS_INDIRECT_JUMP 0x80 // JP V0, addr whose targets are unknown
+
+typedef struct Analysis_t Analysis;
+
+struct Analysis_t
+{
+    uint8_t flags[TOTAL_RAM];
+    uint16_t rom_end; // One past the last ROM byte
+
+    int num_instructions;
+    int num_idle_loops;
+    int num_self_modifying;
+    int num_unknown_stores; // FX33/FX55 whose I could not be determined
+    int num_indirect_jumps;
+    int num_illegal; // Reachable bytes that do not decode
+};
+
+void chip8_analyze(Analysis *analysis, const uint8_t *memory, uint16_t rom_size);
+
+#endif // ANALYSIS_H
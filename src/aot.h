@@ -0,0 +1,72 @@
+#ifndef AOT_H
+#define AOT_H
+
+#include "chip8.h"
+#include "instructions.h"
+
+/*
+ * Interface between a ROM translated by chip8-aot and the host that runs it.
+ * The generated C file defines the image and aot_run_frame; everything below
+ * the declarations is used by the generated code.
+ */
+
+// Memory at power-on, font and ROM included, that the translation was made from
+extern const uint8_t aot_image[TOTAL_RAM];
+extern const uint16_t aot_rom_size;
+
+// Run up to the next frame boundary; returns CHIP8_FRAME or a fault
+Chip8Status aot_run_frame(Chip8 *chip8);
+
+/*
+ * Count a cycle and tick the timers at frame boundaries, like the interpreter
+ */
+static inline bool aot_tick(Chip8 *chip8)
+{
+    chip8->cycles++;
+    if (chip8->cycles != chip8->next_frame)
+        return false;
+
+    chip8->next_frame += chip8->cycles_per_frame;
+
+    if (chip8->delay_timer > 0)
+        chip8->delay_timer--;
+    if (chip8->sound_timer > 0)
+        chip8->sound_timer--;
+
+    return true;
+}
+
+/*
+ * Check whether a store changed any byte the translation was made from.
+ * code_map has a bit per address that belongs to a translated instruction.
+ */
+static inline bool aot_code_changed(const Chip8 *chip8, const uint8_t *code_map, uint16_t start,
+                                    unsigned int length)
+{
+    for (unsigned int i = 0; i < length; i++)
+    {
+        uint16_t address = (start + i) & RAM_MASK;
+        if ((code_map[address >> 3] & (1 << (address & 7))) &&
+            chip8_read(chip8, address) != aot_image[address])
+            return true;
+    }
+
+    return false;
+}
+
+/*
+ * Check whether the instruction the interpreter just ran, with I at start
+ * before it, was a store that changed translated code
+ */
+static inline bool aot_store_changed_code(const Chip8 *chip8, const uint8_t *code_map, uint16_t start)
+{
+    uint16_t opcode = chip8->current_op;
+    if ((opcode & 0xF0FF) == 0xF033)
+        return aot_code_changed(chip8, code_map, start, 3);
+    if ((opcode & 0xF0FF) == 0xF055)
+        return aot_code_changed(chip8, code_map, start, ((opcode & 0x0F00) >> 8) + 1);
+
+    return false;
+}
+
+#endif // AOT_H
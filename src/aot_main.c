@@ -0,0 +1,109 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "aot.h"
+#include "governor.h"
+#include "platform.h"
+
+#define USAGE "Usage: %s <scale> [--hz <n>|max]\n"
+
+/*
+ * Frontend for a ROM compiled ahead of time: the ROM is built in, and each
+ * frame runs the translated code instead of the interpreter
+ */
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        printf(USAGE, argv[0]);
+        return 1;
+    }
+
+    char *endptr;
+    int screenScale = strtol(argv[1], &endptr, 10);
+    if (*endptr != '\0')
+    {
+        printf("Invalid character in scale value: %c\n", *endptr);
+        return 1;
+    }
+
+    unsigned int hz = GOVERNOR_DEFAULT_HZ;
+    for (int i = 2; i < argc; i++)
+    {
+        const char *option = argv[i];
+        bool valid = i + 1 < argc;
+
+        if (strcmp(option, "--hz") == 0 && valid && strcmp(argv[i + 1], "max") == 0)
+        {
+            hz = GOVERNOR_UNPACED;
+            i++;
+        }
+        else if (strcmp(option, "--hz") == 0)
+        {
+            if (valid)
+                hz = strtoul(argv[++i], &endptr, 10);
+            valid = valid && *endptr == '\0' && hz > 0;
+        }
+        else
+        {
+            valid = false;
+        }
+
+        if (!valid)
+        {
+            printf("Invalid option: %s\n", option);
+            printf(USAGE, argv[0]);
+            return 1;
+        }
+    }
+
+    Platform platform;
+    if (!platform_init(&platform, SCREEN_WIDTH * screenScale, SCREEN_HEIGHT * screenScale))
+        return 1;
+    if (!platform_init_renderer(&platform))
+    {
+        platform_cleanup(&platform);
+        return 1;
+    }
+
+    Chip8 chip8;
+    chip8_init(&chip8);
+    chip8_seed(&chip8, (uint32_t)time(NULL));
+    chip8_write_block(&chip8, START_ADDRESS, &aot_image[START_ADDRESS], aot_rom_size);
+
+    int pitch = sizeof(chip8.screen[0]) * SCREEN_WIDTH;
+
+    // --hz sets the CPU clock; the timers and the governor's frames stay at 60 Hz
+    if (hz != GOVERNOR_UNPACED)
+        hz = chip8_set_clock(&chip8, hz);
+
+    Governor governor;
+    governor_init(&governor, hz);
+
+    while (chip8.is_running)
+    {
+        platform_process_input(&platform, &chip8);
+
+        if (!chip8.is_paused)
+        {
+            Chip8Status status = aot_run_frame(&chip8);
+            if (CHIP8_IS_FAULT(status))
+            {
+                printf("Stopped: %s at 0x%03X (opcode 0x%04X)\n",
+                       chip8_status_string(status), chip8.fault_pc, chip8.current_op);
+                break;
+            }
+        }
+
+        if (governor_end_frame(&governor))
+            platform_update(&platform, &chip8, pitch);
+
+        governor_wait(&governor, chip8.cycles);
+    }
+
+    chip8_release(&chip8);
+    platform_cleanup(&platform);
+    return 0;
+}
@@ -1,18 +1,52 @@
 #include "chip8.h"
 #include "instructions.h"
+#include "metrics.h"
+#include "trace.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 /*
- * Initialize the system to the startup state
+ * Page 0 of RAM: the font sprites at address 0 followed by zeros
+ */
+static const uint8_t FONT_PAGE[RAM_PAGE_SIZE] =
+    {
+        0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
+        0x20, 0x60, 0x20, 0x20, 0x70, // 1
+        0xF0, 0x10, 0xF0, 0x80, 0xF0, // 2
+        0xF0, 0x10, 0xF0, 0x10, 0xF0, // 3
+        0x90, 0x90, 0xF0, 0x10, 0x10, // 4
+        0xF0, 0x80, 0xF0, 0x10, 0xF0, // 5
+        0xF0, 0x80, 0xF0, 0x90, 0xF0, // 6
+        0xF0, 0x10, 0x20, 0x40, 0x40, // 7
+        0xF0, 0x90, 0xF0, 0x90, 0xF0, // 8
+        0xF0, 0x90, 0xF0, 0x10, 0xF0, // 9
+        0xF0, 0x90, 0xF0, 0x90, 0x90, // A
+        0xE0, 0x90, 0xE0, 0x90, 0xE0, // B
+        0xF0, 0x80, 0x80, 0x80, 0xF0, // C
+        0xE0, 0x90, 0x90, 0x90, 0xE0, // D
+        0xF0, 0x80, 0xF0, 0x80, 0xF0, // E
+        0xF0, 0x80, 0xF0, 0x80, 0x80  // F
+};
+
+static const uint8_t ZERO_PAGE[RAM_PAGE_SIZE];
+
+/*
+ * Initialize the system to the startup state. RAM starts out mapped to the
+ * shared font and zero pages, so a fresh instance owns no pages.
  */
 void chip8_init(Chip8 *chip8)
 {
     chip8->is_running = true;
     chip8->is_paused = false;
+    chip8->step_requested = false;
+    chip8->step_over_requested = false;
     chip8->current_op = 0;
+    chip8->fault_pc = 0;
+    chip8->cycles = 0;
+    chip8->cycles_per_frame = CYCLES_PER_FRAME;
+    chip8->next_frame = CYCLES_PER_FRAME;
 
     // Initialize special registers
     chip8->PC = START_ADDRESS;
@@ -25,70 +59,310 @@ void chip8_init(Chip8 *chip8)
     // Clear stack
     memset(chip8->stack, 0, sizeof(chip8->stack));
 
-    // Clear memory
-    memset(chip8->memory, 0, sizeof(chip8->memory));
+    // Map memory to the fontset followed by zeros
+    chip8->dirty_pages = 0;
+    chip8->out_of_memory = false;
+    chip8->pages[0] = (uint8_t *)FONT_PAGE;
+    for (int page = 1; page < NUM_RAM_PAGES; page++)
+    {
+        chip8->pages[page] = (uint8_t *)ZERO_PAGE;
+    }
 
     // Clear registers
     memset(chip8->V, 0, sizeof(chip8->V));
 
-    // Load fonts into memory
-    for (int i = 0; i < FONTSET_SIZE; ++i)
-    {
-        chip8->memory[i] = FONTSET[i];
-    }
-
     // Initialize timers
     chip8->delay_timer = 0;
     chip8->sound_timer = 0;
 
     // Set up keyboard
     memset(chip8->keypad, false, sizeof(chip8->keypad));
+
+    // Use a fixed seed so headless runs are deterministic by default
+    chip8_seed(chip8, 1);
 }
 
-void chip8_load_rom(Chip8 *chip8, const char *rom_filename)
+/*
+ * Free the pages this instance owns and map RAM back to the shared zero page
+ */
+void chip8_release(Chip8 *chip8)
+{
+    for (int page = 0; page < NUM_RAM_PAGES; page++)
+    {
+        if (chip8->dirty_pages & (1u << page))
+            free(chip8->pages[page]);
+        chip8->pages[page] = (uint8_t *)ZERO_PAGE;
+    }
+
+    chip8->dirty_pages = 0;
+}
+
+/*
+ * Give the instance a private copy of a page before its first write.
+ * Returns false, and sets out_of_memory, if the copy could not be allocated.
+ */
+bool chip8_copy_page(Chip8 *chip8, unsigned int page)
+{
+    uint8_t *copy = malloc(RAM_PAGE_SIZE);
+    if (copy == NULL)
+    {
+        chip8->out_of_memory = true;
+        return false;
+    }
+
+    memcpy(copy, chip8->pages[page], RAM_PAGE_SIZE);
+    chip8->pages[page] = copy;
+    chip8->dirty_pages |= 1u << page;
+    return true;
+}
+
+/*
+ * Make dest an independent copy of src. Shared pages stay shared; only the
+ * pages src owns are duplicated. dest must not own any pages.
+ */
+bool chip8_clone(Chip8 *dest, const Chip8 *src)
+{
+    *dest = *src;
+    dest->dirty_pages = 0;
+
+    for (int page = 0; page < NUM_RAM_PAGES; page++)
+    {
+        if ((src->dirty_pages & (1u << page)) && !chip8_copy_page(dest, page))
+        {
+            chip8_release(dest);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*
+ * Copy a block of bytes out of guest memory, a page at a time, wrapping the
+ * address around RAM
+ */
+void chip8_read_block(const Chip8 *chip8, uint16_t address, uint8_t *data, size_t size)
+{
+    while (size > 0)
+    {
+        address &= RAM_MASK;
+        size_t offset = address & RAM_PAGE_MASK;
+        size_t length = RAM_PAGE_SIZE - offset;
+        if (length > size)
+            length = size;
+
+        memcpy(data, &chip8->pages[address >> RAM_PAGE_SHIFT][offset], length);
+        address += length;
+        data += length;
+        size -= length;
+    }
+}
+
+/*
+ * Copy a block of bytes into guest memory, a page at a time
+ */
+void chip8_write_block(Chip8 *chip8, uint16_t address, const uint8_t *data, size_t size)
+{
+    while (size > 0)
+    {
+        address &= RAM_MASK;
+        unsigned int page = address >> RAM_PAGE_SHIFT;
+        size_t offset = address & RAM_PAGE_MASK;
+        size_t length = RAM_PAGE_SIZE - offset;
+        if (length > size)
+            length = size;
+
+        if (!(chip8->dirty_pages & (1u << page)) && !chip8_copy_page(chip8, page))
+            return;
+
+        memcpy(&chip8->pages[page][offset], data, length);
+        address += length;
+        data += length;
+        size -= length;
+    }
+}
+
+/*
+ * Seed the random number generator used by CXKK
+ */
+void chip8_seed(Chip8 *chip8, uint32_t seed)
+{
+    // Xorshift state must never be zero
+    chip8->rng_state = seed ? seed : 1;
+}
+
+/*
+ * Run the CPU at hz instructions per second, rounded to a whole number of
+ * instructions per 60 Hz timer tick, and start a new frame. The timers keep
+ * ticking at 60 Hz. Returns the rate actually used.
+ */
+unsigned int chip8_set_clock(Chip8 *chip8, unsigned int hz)
+{
+    unsigned int cycles_per_frame = (hz + TIMER_HZ / 2) / TIMER_HZ;
+    if (cycles_per_frame == 0)
+        cycles_per_frame = 1;
+    if (cycles_per_frame > UINT16_MAX)
+        cycles_per_frame = UINT16_MAX;
+
+    chip8->cycles_per_frame = cycles_per_frame;
+    chip8->next_frame = chip8->cycles + cycles_per_frame;
+    return cycles_per_frame * TIMER_HZ;
+}
+
+/*
+ * Read a ROM file into buffer, which holds everything above START_ADDRESS.
+ * Returns the ROM size, or -1 on failure.
+ */
+static long read_rom(const char *rom_filename, uint8_t *buffer)
 {
     FILE *rom = fopen(rom_filename, "rb");
     if (rom == NULL)
     {
         perror("Failed to open ROM");
-        exit(EXIT_FAILURE);
+        return -1;
     }
 
     // Get the size of the ROM
     fseek(rom, 0, SEEK_END);
     long rom_size = ftell(rom);
-
-    // Allocate memory for a buffer to hold the ROM
-    uint8_t *rom_buffer = (uint8_t *)malloc(sizeof(uint8_t) * rom_size);
-    if (rom_buffer == NULL)
+    if (rom_size < 0 || rom_size > TOTAL_RAM - START_ADDRESS)
     {
-        perror("Failed to allocate memory for ROM");
+        printf("ROM does not fit in memory: %ld bytes\n", rom_size);
         fclose(rom);
-        exit(EXIT_FAILURE);
+        return -1;
     }
 
     // Go to the beginning of the file and read the ROM into the buffer
     rewind(rom);
-    size_t bytes_read = fread(rom_buffer, 1, rom_size, rom);
-    if (bytes_read != rom_size)
+    size_t bytes_read = fread(buffer, 1, rom_size, rom);
+    fclose(rom);
+    if (bytes_read != (size_t)rom_size)
     {
         perror("Failed to read full ROM");
-        free(rom_buffer);
-        fclose(rom);
-        exit(EXIT_FAILURE);
+        return -1;
     }
-    fclose(rom);
+
+    return rom_size;
+}
+
+/*
+ * Load a ROM file into memory at the program start address. The pages it
+ * covers become private to this instance.
+ */
+bool chip8_load_rom(Chip8 *chip8, const char *rom_filename)
+{
+    uint8_t rom_buffer[TOTAL_RAM - START_ADDRESS];
+    long rom_size = read_rom(rom_filename, rom_buffer);
+    if (rom_size < 0)
+        return false;
 
     // Copy the ROM to CHIP-8 memory
-    memcpy(&chip8->memory[START_ADDRESS], rom_buffer, rom_size);
-    free(rom_buffer);
+    chip8_write_block(chip8, START_ADDRESS, rom_buffer, rom_size);
+    if (chip8->out_of_memory)
+    {
+        printf("Failed to allocate memory for ROM\n");
+        return false;
+    }
+
+    return true;
+}
+
+/*
+ * Set up an image holding only the fontset
+ */
+void chip8_image_init(Chip8Image *image)
+{
+    memset(image->memory, 0, sizeof(image->memory));
+    memcpy(image->memory, FONT_PAGE, sizeof(FONT_PAGE));
+    image->rom_size = 0;
+}
+
+/*
+ * Load a ROM file into an image at the program start address
+ */
+bool chip8_image_load_rom(Chip8Image *image, const char *rom_filename)
+{
+    long rom_size = read_rom(rom_filename, &image->memory[START_ADDRESS]);
+    if (rom_size < 0)
+        return false;
+
+    image->rom_size = rom_size;
+    return true;
+}
+
+/*
+ * Map an instance's RAM onto a shared image. The image must stay alive and
+ * unchanged for as long as any instance is attached to it.
+ */
+void chip8_attach_image(Chip8 *chip8, const Chip8Image *image)
+{
+    chip8_release(chip8);
+
+    for (int page = 0; page < NUM_RAM_PAGES; page++)
+    {
+        chip8->pages[page] = (uint8_t *)&image->memory[page * RAM_PAGE_SIZE];
+    }
+}
+
+/*
+ * Rewind to the faulting instruction and record where it happened
+ */
+static Chip8Status fault(Chip8 *chip8, Chip8Status status)
+{
+    chip8->PC -= 2;
+    chip8->fault_pc = chip8->PC;
+
+    TRACE_RECORD(chip8->PC, chip8->current_op, chip8->I, chip8->V[(chip8->current_op & 0x0F00) >> 8],
+                 chip8->V[0xF]);
+    TRACE_FAULT(status);
+    return status;
 }
 
-void chip8_cycle(Chip8 *chip8)
+/*
+ * Where a block of guest memory starts, if it does not cross a page, or NULL.
+ * Blocks to be written must also be in a page this instance owns.
+ */
+static inline uint8_t *page_block(const Chip8 *chip8, uint16_t address, unsigned int size, bool write)
+{
+    address &= RAM_MASK;
+    unsigned int page = address >> RAM_PAGE_SHIFT;
+    unsigned int offset = address & RAM_PAGE_MASK;
+
+    if (offset + size > RAM_PAGE_SIZE || (write && !(chip8->dirty_pages & (1u << page))))
+        return NULL;
+
+    return &chip8->pages[page][offset];
+}
+
+/*
+ * Count an executed instruction and tick the timers at each 60 Hz frame boundary.
+ * Returns true when a frame has ended.
+ */
+static bool end_cycle(Chip8 *chip8)
+{
+    chip8->cycles++;
+    if (chip8->cycles != chip8->next_frame)
+        return false;
+
+    chip8->next_frame += chip8->cycles_per_frame;
+
+    if (chip8->delay_timer > 0)
+        chip8->delay_timer--;
+    if (chip8->sound_timer > 0)
+        chip8->sound_timer--;
+
+    return true;
+}
+
+/*
+ * Fetch, decode and execute one instruction through the opcode handlers
+ */
+static Chip8Status execute(Chip8 *chip8)
 {
     // Fetch the next instruction as an opcode
-    uint8_t MSB = chip8->memory[chip8->PC];
-    uint8_t LSB = chip8->memory[chip8->PC + 1];
+    uint16_t address = chip8->PC;
+    uint8_t MSB = chip8_read(chip8, address);
+    uint8_t LSB = chip8_read(chip8, address + 1);
     uint16_t opcode = (MSB << 8) | LSB;
     chip8->current_op = opcode;
 
@@ -108,11 +382,12 @@ void chip8_cycle(Chip8 *chip8)
             break;
         case 0x00EE:
             // RET
+            if (chip8->SP == 0)
+                return fault(chip8, CHIP8_STACK_UNDERFLOW);
             op_0x00EE(chip8);
             break;
         default:
-            printf("Unrecognized opcode 0x%X\n", opcode);
-            exit(EXIT_FAILURE);
+            return fault(chip8, CHIP8_ILLEGAL_OPCODE);
         }
         break;
 
@@ -123,6 +398,8 @@ void chip8_cycle(Chip8 *chip8)
 
     case 0x2000:
         // CALL
+        if (chip8->SP >= STACK_SIZE)
+            return fault(chip8, CHIP8_STACK_OVERFLOW);
         op_0x2NNN(chip8);
         break;
 
@@ -191,8 +468,7 @@ void chip8_cycle(Chip8 *chip8)
             op_0x8XYE(chip8);
             break;
         default:
-            printf("Unrecognized opcode 0x%X\n", opcode);
-            exit(EXIT_FAILURE);
+            return fault(chip8, CHIP8_ILLEGAL_OPCODE);
         }
         break;
 
@@ -219,7 +495,9 @@ void chip8_cycle(Chip8 *chip8)
     case 0xD000:
         // DRW Vx, Vy, nibble
         op_0xDXYN(chip8);
-        break;
+        METRICS_ADD(draws, 1);
+        METRICS_ADD(collisions, chip8->V[0xF]);
+        return CHIP8_DRAW;
 
     case 0xE000:
         switch (opcode & 0x00FF)
@@ -233,8 +511,7 @@ void chip8_cycle(Chip8 *chip8)
             op_0xEXA1(chip8);
             break;
         default:
-            printf("Unrecognized opcode 0x%X\n", opcode);
-            exit(EXIT_FAILURE);
+            return fault(chip8, CHIP8_ILLEGAL_OPCODE);
         }
         break;
 
@@ -248,6 +525,11 @@ void chip8_cycle(Chip8 *chip8)
         case 0x000A:
             // LD Vx, K
             op_0xFX0A(chip8);
+            if (chip8->PC == address)
+            {
+                METRICS_ADD(key_wait_cycles, 1);
+                return CHIP8_KEY_WAIT;
+            }
             break;
         case 0x0015:
             // LD DT, Vx
@@ -268,23 +550,366 @@ void chip8_cycle(Chip8 *chip8)
         case 0x0033:
             // LD B, Vx
             op_0xFX33(chip8);
+            if (chip8->out_of_memory)
+                return fault(chip8, CHIP8_OUT_OF_MEMORY);
             break;
         case 0x0055:
             // LD [I], Vx
             op_0xFX55(chip8);
+            if (chip8->out_of_memory)
+                return fault(chip8, CHIP8_OUT_OF_MEMORY);
             break;
         case 0x0065:
             // LD Vx, [I]
             op_0xFX65(chip8);
             break;
         default:
-            printf("Unrecognized opcode 0x%X\n", opcode);
-            exit(EXIT_FAILURE);
+            return fault(chip8, CHIP8_ILLEGAL_OPCODE);
         }
         break;
 
     default:
-        printf("Unrecognized opcode 0x%X\n", opcode);
-        exit(EXIT_FAILURE);
+        return fault(chip8, CHIP8_ILLEGAL_OPCODE);
+    }
+
+    return CHIP8_OK;
+}
+
+/*
+ * Execute a single instruction. Faults take precedence over a frame boundary,
+ * which takes precedence over the instruction's own event.
+ */
+Chip8Status chip8_cycle(Chip8 *chip8)
+{
+    uint16_t address = chip8->PC;
+    Chip8Status status = execute(chip8);
+    if (CHIP8_IS_FAULT(status))
+        return status;
+
+    METRICS_ADD(instructions[chip8->current_op >> 12], 1);
+    TRACE_RECORD(address, chip8->current_op, chip8->I, chip8->V[(chip8->current_op & 0x0F00) >> 8],
+                 chip8->V[0xF]);
+    (void)address; // Only recorded when tracing is compiled in
+    if (end_cycle(chip8))
+        return CHIP8_FRAME;
+
+    return status;
+}
+
+/*
+ * Body of chip8_run, inlined once with tracing and once without. Forced,
+ * since it is too big for the compiler to inline twice by itself.
+ */
+static inline __attribute__((always_inline)) Chip8Status run(Chip8 *chip8, unsigned int max_cycles, unsigned int stop_mask, bool traced)
+{
+    uint16_t pc = chip8->PC;
+    uint16_t I = chip8->I;
+    uint8_t V[NUM_REGISTERS];
+    memcpy(V, chip8->V, sizeof(V));
+
+    uint16_t opcode = chip8->current_op;
+    Chip8Status status = CHIP8_OK;
+    TRACE_RUN_BEGIN();
+
+    for (unsigned int i = 0; i < max_cycles; i++)
+    {
+        uint16_t address = pc;
+        opcode = (chip8_read(chip8, pc) << 8) | chip8_read(chip8, pc + 1);
+        pc += 2;
+
+        uint8_t x = (opcode & 0x0F00) >> 8;
+        uint8_t y = (opcode & 0x00F0) >> 4;
+        uint8_t kk = opcode & 0x00FF;
+        uint16_t nnn = opcode & 0x0FFF;
+        uint16_t sum;
+
+        // Faults and the less frequent opcodes are left to the handlers
+        bool slow = false;
+        status = CHIP8_OK;
+        switch (opcode & 0xF000)
+        {
+        case 0x0000:
+            if (opcode == 0x00EE)
+            {
+                // RET
+                if (chip8->SP == 0)
+                {
+                    slow = true;
+                    break;
+                }
+                chip8->SP--;
+                pc = chip8->stack[chip8->SP & STACK_MASK];
+            }
+            else
+            {
+                slow = true;
+            }
+            break;
+
+        case 0x1000:
+            // JP
+            pc = nnn;
+            break;
+
+        case 0x2000:
+            // CALL
+            if (chip8->SP >= STACK_SIZE)
+            {
+                slow = true;
+                break;
+            }
+            chip8->stack[chip8->SP & STACK_MASK] = pc;
+            chip8->SP++;
+            pc = nnn;
+            break;
+
+        case 0x3000:
+            // SE Vx, byte
+            if (V[x] == kk)
+                pc += 2;
+            break;
+
+        case 0x4000:
+            // SNE Vx, byte
+            if (V[x] != kk)
+                pc += 2;
+            break;
+
+        case 0x5000:
+            // SE Vx, Vy
+            if (V[x] == V[y])
+                pc += 2;
+            break;
+
+        case 0x6000:
+            // LD Vx, byte
+            V[x] = kk;
+            break;
+
+        case 0x7000:
+            // ADD Vx, byte
+            V[x] += kk;
+            break;
+
+        case 0x8000:
+            switch (opcode & 0x000F)
+            {
+            case 0x0000:
+                V[x] = V[y];
+                break;
+            case 0x0001:
+                V[x] |= V[y];
+                break;
+            case 0x0002:
+                V[x] &= V[y];
+                break;
+            case 0x0003:
+                V[x] ^= V[y];
+                break;
+            case 0x0004:
+                sum = V[x] + V[y];
+                V[0xF] = sum > 255;
+                V[x] = sum & 0xFF;
+                break;
+            case 0x0005:
+                V[0xF] = V[x] > V[y];
+                V[x] -= V[y];
+                break;
+            case 0x0006:
+                V[0xF] = V[x] & 1;
+                V[x] >>= 1;
+                break;
+            case 0x0007:
+                V[0xF] = V[y] > V[x];
+                V[x] = V[y] - V[x];
+                break;
+            case 0x000E:
+                V[0xF] = V[x] >> 7;
+                V[x] <<= 1;
+                break;
+            default:
+                slow = true;
+            }
+            break;
+
+        case 0x9000:
+            // SNE Vx, Vy
+            if (V[x] != V[y])
+                pc += 2;
+            break;
+
+        case 0xA000:
+            // LD I, addr
+            I = nnn;
+            break;
+
+        case 0xB000:
+            // JP V0, addr
+            pc = nnn + V[0];
+            break;
+
+        case 0xE000:
+            if (kk == 0x9E)
+            {
+                // SKP
+                if (chip8->keypad[V[x] & 0xF])
+                    pc += 2;
+            }
+            else if (kk == 0xA1)
+            {
+                // SKNP
+                if (!chip8->keypad[V[x] & 0xF])
+                    pc += 2;
+            }
+            else
+            {
+                slow = true;
+            }
+            break;
+
+        case 0xF000:
+            if (kk == 0x07)
+            {
+                // LD Vx, DT
+                V[x] = chip8->delay_timer;
+                break;
+            }
+            if (kk == 0x15)
+            {
+                // LD DT, Vx
+                chip8->delay_timer = V[x];
+                break;
+            }
+            if (kk == 0x18)
+            {
+                // LD ST, Vx
+                chip8->sound_timer = V[x];
+                break;
+            }
+            if (kk == 0x1E)
+            {
+                // ADD I, Vx
+                I += V[x];
+                break;
+            }
+
+            // Block transfers within one page; the handlers deal with page
+            // boundaries and copying shared pages
+            if (kk == 0x33 || kk == 0x55 || kk == 0x65)
+            {
+                unsigned int size = kk == 0x33 ? 3 : x + 1;
+                uint8_t *block = page_block(chip8, I, size, kk != 0x65);
+                if (block == NULL)
+                    slow = true;
+                else if (kk == 0x33)
+                    memcpy(block, BCD_TABLE[V[x]], 3); // LD B, Vx
+                else if (kk == 0x55)
+                    memcpy(block, V, size); // LD [I], Vx
+                else
+                    memcpy(V, block, size); // LD Vx, [I]
+                break;
+            }
+            slow = true;
+            break;
+
+        default:
+            slow = true;
+            break;
+        }
+
+        if (slow)
+        {
+            // Write the locals back, rerun the instruction through its handler and reload
+            chip8->PC = pc - 2;
+            chip8->I = I;
+            memcpy(chip8->V, V, sizeof(V));
+
+            // A fault records and dumps through the ring itself
+            if (traced)
+                TRACE_RUN_SAVE();
+            status = execute(chip8);
+            if (traced)
+                TRACE_RUN_LOAD();
+
+            pc = chip8->PC;
+            I = chip8->I;
+            memcpy(V, chip8->V, sizeof(V));
+
+            if (CHIP8_IS_FAULT(status))
+                break;
+        }
+
+        METRICS_ADD(instructions[opcode >> 12], 1);
+        if (traced)
+            TRACE_RUN_RECORD(address, opcode, I, V[x], V[0xF]);
+        (void)address; // Only recorded when tracing is compiled in
+        if (end_cycle(chip8) && (stop_mask & CHIP8_STOP_ON(CHIP8_FRAME)))
+        {
+            status = CHIP8_FRAME;
+            break;
+        }
+
+        if (stop_mask & CHIP8_STOP_ON(status))
+            break;
+
+        status = CHIP8_OK;
+    }
+
+    // Write the hoisted registers back
+    chip8->PC = pc;
+    chip8->I = I;
+    memcpy(chip8->V, V, sizeof(V));
+    chip8->current_op = opcode;
+    if (traced)
+        TRACE_RUN_SAVE();
+
+    return status;
+}
+
+/*
+ * Execute up to max_cycles instructions, stopping early on a fault or on any
+ * event selected in stop_mask with CHIP8_STOP_ON. Returns CHIP8_OK if every
+ * cycle ran.
+ *
+ * This is the fast path: PC, I and the V registers live in locals across
+ * instructions, and are only written back around the handlers that touch the
+ * rest of the machine. It must stay equivalent to chip8_cycle.
+ */
+Chip8Status chip8_run(Chip8 *chip8, unsigned int max_cycles, unsigned int stop_mask)
+{
+    // Choose once per call, so the loop that is not traced has no trace code in it
+    if (TRACE_ACTIVE())
+        return run(chip8, max_cycles, stop_mask, true);
+
+    return run(chip8, max_cycles, stop_mask, false);
+}
+
+/*
+ * Describe a status code for diagnostics
+ */
+const char *chip8_status_string(Chip8Status status)
+{
+    switch (status)
+    {
+    case CHIP8_OK:
+        return "ok";
+    case CHIP8_DRAW:
+        return "draw";
+    case CHIP8_FRAME:
+        return "frame";
+    case CHIP8_KEY_WAIT:
+        return "waiting for key";
+    case CHIP8_BREAKPOINT:
+        return "breakpoint";
+    case CHIP8_ILLEGAL_OPCODE:
+        return "illegal opcode";
+    case CHIP8_STACK_OVERFLOW:
+        return "stack overflow";
+    case CHIP8_STACK_UNDERFLOW:
+        return "stack underflow";
+    case CHIP8_OUT_OF_MEMORY:
+        return "out of memory";
+    default:
+        return "unknown status";
     }
 }
@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 #define NUM_REGISTERS 16
 #define TOTAL_RAM 4096
@@ -13,55 +14,149 @@
 #define FONTSET_START_ADDRESS 0x500
 #define START_ADDRESS 0x200
 
+// Guest addresses and stack slots wrap by masking; both sizes must be powers of two
+#define RAM_MASK (TOTAL_RAM - 1)
+#define STACK_MASK (STACK_SIZE - 1)
+
+#define CACHE_LINE_SIZE 64
+
+// RAM is mapped in pages so instances can share unmodified pages
+#define RAM_PAGE_SHIFT 8
+#define RAM_PAGE_SIZE (1 << RAM_PAGE_SHIFT)
+#define RAM_PAGE_MASK (RAM_PAGE_SIZE - 1)
+#define NUM_RAM_PAGES (TOTAL_RAM / RAM_PAGE_SIZE)
+
+// The delay and sound timers count down at 60 Hz whatever the CPU clock
+#define TIMER_HZ 60
+
+// Default instructions per 60 Hz frame, giving a 600 Hz CPU clock
+#define CYCLES_PER_FRAME 10
+
 #define SCREEN_WIDTH 64
 #define SCREEN_HEIGHT 32
 
-static const uint8_t FONTSET[FONTSET_SIZE] =
-    {
-        0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
-        0x20, 0x60, 0x20, 0x20, 0x70, // 1
-        0xF0, 0x10, 0xF0, 0x80, 0xF0, // 2
-        0xF0, 0x10, 0xF0, 0x10, 0xF0, // 3
-        0x90, 0x90, 0xF0, 0x10, 0x10, // 4
-        0xF0, 0x80, 0xF0, 0x10, 0xF0, // 5
-        0xF0, 0x80, 0xF0, 0x90, 0xF0, // 6
-        0xF0, 0x10, 0x20, 0x40, 0x40, // 7
-        0xF0, 0x90, 0xF0, 0x90, 0xF0, // 8
-        0xF0, 0x90, 0xF0, 0x10, 0xF0, // 9
-        0xF0, 0x90, 0xF0, 0x90, 0x90, // A
-        0xE0, 0x90, 0xE0, 0x90, 0xE0, // B
-        0xF0, 0x80, 0x80, 0x80, 0xF0, // C
-        0xE0, 0x90, 0x90, 0x90, 0xE0, // D
-        0xF0, 0x80, 0xF0, 0x80, 0xF0, // E
-        0xF0, 0x80, 0xF0, 0x80, 0x80  // F
-};
-
 typedef struct Chip8_t Chip8;
+typedef struct Chip8Image_t Chip8Image;
 
-struct Chip8_t
+typedef enum Chip8Status_t
 {
-    uint8_t memory[TOTAL_RAM];
-    uint16_t stack[STACK_SIZE];
+    CHIP8_OK,
+    CHIP8_DRAW,       // DXYN changed the screen
+    CHIP8_FRAME,      // A 60 Hz frame ended and the timers ticked
+    CHIP8_KEY_WAIT,   // FX0A is blocked until a key is pressed
+    CHIP8_BREAKPOINT, // Execution stopped at a debugger breakpoint
 
+    // Faults; fault_pc and current_op identify the instruction
+    CHIP8_ILLEGAL_OPCODE,
+    CHIP8_STACK_OVERFLOW,
+    CHIP8_STACK_UNDERFLOW,
+    CHIP8_OUT_OF_MEMORY, // A page could not be copied on write
+} Chip8Status;
+
+#define CHIP8_IS_FAULT(status) ((status) >= CHIP8_ILLEGAL_OPCODE)
+
+// Stop masks for chip8_run; faults always stop
+#define CHIP8_STOP_ON(status) (1u << (status))
+#define CHIP8_STOP_ALL (~0u)
+
+/*
+ * The fields the interpreter touches on every instruction come first and fit in
+ * one cache line. The page table, which every fetch reads, starts on the very
+ * next line, so fetching only touches the front of the struct. The display
+ * starts on a cache line of its own, and the struct size is a multiple of the
+ * line size, so instances packed in an array never share a line.
+ */
+struct Chip8_t
+{
+    // Hot interpreter state
+    uint64_t cycles; // Instructions executed since init
     uint8_t V[NUM_REGISTERS];
     uint16_t I;  // Index register
     uint16_t PC; // Program counter
-    uint8_t SP;  // Stack pointer
+    uint16_t current_op;
+    uint8_t SP; // Stack pointer
     uint8_t delay_timer;
     uint8_t sound_timer;
-
     uint8_t keypad[NUM_KEYS];
-    uint32_t screen[SCREEN_WIDTH * SCREEN_HEIGHT];
+    uint16_t cycles_per_frame; // Instructions per 60 Hz timer tick, set by chip8_set_clock
 
-    uint16_t current_op;
+    // Per-instance RNG state so runs are reproducible and independent
+    uint32_t rng_state;
+
+    uint64_t next_frame; // Cycle count at which the timers next tick
+
+    // Guest RAM. Pages without a dirty bit are shared and must not be written;
+    // the first write to one copies it into a private page.
+    _Alignas(CACHE_LINE_SIZE) uint8_t *pages[NUM_RAM_PAGES];
+
+    // Warm state, used by calls, faults and the frontend
+    uint16_t stack[STACK_SIZE];
+    uint16_t fault_pc;    // Address of the last faulting instruction
+    uint16_t dirty_pages; // One bit per page owned by this instance
+    bool out_of_memory;   // Set when a copy on write failed
 
     // Execution control flags
     bool is_running;
     bool is_paused;
+    bool step_requested;      // Run one instruction while paused
+    bool step_over_requested; // Run one instruction or a whole CALL while paused
+
+    _Alignas(CACHE_LINE_SIZE) uint32_t screen[SCREEN_WIDTH * SCREEN_HEIGHT];
 };
 
+/*
+ * Read-only RAM contents (fontset and ROM) that any number of instances can map
+ */
+struct Chip8Image_t
+{
+    _Alignas(CACHE_LINE_SIZE) uint8_t memory[TOTAL_RAM];
+    uint16_t rom_size;
+};
+
+_Static_assert(offsetof(struct Chip8_t, pages) == CACHE_LINE_SIZE,
+               "Hot interpreter state must fit in one cache line");
+
+/*
+ * Read a byte of guest memory, wrapping the address into RAM
+ */
+static inline uint8_t chip8_read(const Chip8 *chip8, uint16_t address)
+{
+    address &= RAM_MASK;
+    return chip8->pages[address >> RAM_PAGE_SHIFT][address & RAM_PAGE_MASK];
+}
+
+bool chip8_copy_page(Chip8 *chip8, unsigned int page);
+
+/*
+ * Write a byte of guest memory, wrapping the address into RAM and copying
+ * a shared page first
+ */
+static inline void chip8_write(Chip8 *chip8, uint16_t address, uint8_t value)
+{
+    address &= RAM_MASK;
+    unsigned int page = address >> RAM_PAGE_SHIFT;
+
+    if (!(chip8->dirty_pages & (1u << page)) && !chip8_copy_page(chip8, page))
+        return;
+
+    chip8->pages[page][address & RAM_PAGE_MASK] = value;
+}
+
 void chip8_init(Chip8 *chip8);
-void chip8_load_rom(Chip8 *chip8, const char *rom_filename);
-void chip8_cycle(Chip8 *chip8);
+void chip8_release(Chip8 *chip8);
+bool chip8_clone(Chip8 *dest, const Chip8 *src);
+void chip8_read_block(const Chip8 *chip8, uint16_t address, uint8_t *data, size_t size);
+void chip8_write_block(Chip8 *chip8, uint16_t address, const uint8_t *data, size_t size);
+
+void chip8_image_init(Chip8Image *image);
+bool chip8_image_load_rom(Chip8Image *image, const char *rom_filename);
+void chip8_attach_image(Chip8 *chip8, const Chip8Image *image);
+
+void chip8_seed(Chip8 *chip8, uint32_t seed);
+unsigned int chip8_set_clock(Chip8 *chip8, unsigned int hz);
+bool chip8_load_rom(Chip8 *chip8, const char *rom_filename);
+Chip8Status chip8_cycle(Chip8 *chip8);
+Chip8Status chip8_run(Chip8 *chip8, unsigned int max_cycles, unsigned int stop_mask);
+const char *chip8_status_string(Chip8Status status);
 
 #endif // CHIP8_H
@@ -0,0 +1,216 @@
+#include "debugger.h"
+#include "disassembler.h"
+
+#include <string.h>
+
+/*
+ * Initialize a debugger with no breakpoints or watchpoints
+ */
+void debugger_init(Debugger *debugger)
+{
+    memset(debugger, 0, sizeof(*debugger));
+}
+
+/*
+ * Check whether anything is set that requires the checked dispatch path
+ */
+bool debugger_is_active(const Debugger *debugger)
+{
+    return debugger->num_breakpoints > 0 || debugger->num_watchpoints > 0 ||
+           debugger->register_watches != 0;
+}
+
+static bool is_breakpoint(const Debugger *debugger, uint16_t address)
+{
+    address &= RAM_MASK;
+    return debugger->breakpoints[address >> 3] & (1 << (address & 7));
+}
+
+void debugger_add_breakpoint(Debugger *debugger, uint16_t address)
+{
+    if (is_breakpoint(debugger, address))
+        return;
+
+    address &= RAM_MASK;
+    debugger->breakpoints[address >> 3] |= 1 << (address & 7);
+    debugger->num_breakpoints++;
+}
+
+void debugger_remove_breakpoint(Debugger *debugger, uint16_t address)
+{
+    if (!is_breakpoint(debugger, address))
+        return;
+
+    address &= RAM_MASK;
+    debugger->breakpoints[address >> 3] &= ~(1 << (address & 7));
+    debugger->num_breakpoints--;
+}
+
+/*
+ * Report a breakpoint hit at the current PC
+ */
+static Chip8Status hit_breakpoint(Debugger *debugger, const Chip8 *chip8)
+{
+    printf("Breakpoint at 0x%03X\n", chip8->PC);
+    debugger->resuming = true;
+    return CHIP8_BREAKPOINT;
+}
+
+/*
+ * Stop execution whenever the byte at address changes
+ */
+bool debugger_add_watchpoint(Debugger *debugger, const Chip8 *chip8, uint16_t address)
+{
+    if (debugger->num_watchpoints == MAX_WATCHPOINTS)
+        return false;
+
+    int i = debugger->num_watchpoints++;
+    debugger->watch_addresses[i] = address & RAM_MASK;
+    debugger->watch_values[i] = chip8_read(chip8, address);
+    return true;
+}
+
+/*
+ * Stop execution whenever register Vx changes
+ */
+void debugger_watch_register(Debugger *debugger, const Chip8 *chip8, uint8_t x)
+{
+    x &= 0xF;
+    debugger->register_watches |= 1 << x;
+    debugger->register_values[x] = chip8->V[x];
+}
+
+/*
+ * Compare every watched location with its last value. Returns true if any changed.
+ */
+static bool check_watchpoints(Debugger *debugger, const Chip8 *chip8)
+{
+    bool hit = false;
+
+    for (int i = 0; i < debugger->num_watchpoints; i++)
+    {
+        uint8_t value = chip8_read(chip8, debugger->watch_addresses[i]);
+        if (value == debugger->watch_values[i])
+            continue;
+
+        printf("Watchpoint [0x%03X]: 0x%02X -> 0x%02X\n",
+               debugger->watch_addresses[i], debugger->watch_values[i], value);
+        debugger->watch_values[i] = value;
+        hit = true;
+    }
+
+    for (int x = 0; x < NUM_REGISTERS; x++)
+    {
+        if (!(debugger->register_watches & (1 << x)) || chip8->V[x] == debugger->register_values[x])
+            continue;
+
+        printf("Watchpoint V%X: 0x%02X -> 0x%02X\n", x, debugger->register_values[x], chip8->V[x]);
+        debugger->register_values[x] = chip8->V[x];
+        hit = true;
+    }
+
+    return hit;
+}
+
+/*
+ * Execute one instruction and check the watchpoints afterwards
+ */
+Chip8Status debugger_step(Debugger *debugger, Chip8 *chip8)
+{
+    uint16_t address = chip8->PC;
+    debugger->resuming = false;
+
+    Chip8Status status = chip8_cycle(chip8);
+    if (CHIP8_IS_FAULT(status))
+        return status;
+
+    if (check_watchpoints(debugger, chip8))
+    {
+        printf("  after 0x%03X\n", address);
+        return CHIP8_BREAKPOINT;
+    }
+
+    return status;
+}
+
+/*
+ * Checked counterpart of chip8_run: stops before any instruction with a
+ * breakpoint and after any instruction that changes a watched location.
+ */
+Chip8Status debugger_run(Debugger *debugger, Chip8 *chip8, unsigned int max_cycles,
+                         unsigned int stop_mask)
+{
+    for (unsigned int i = 0; i < max_cycles; i++)
+    {
+        if (!debugger->resuming && is_breakpoint(debugger, chip8->PC))
+            return hit_breakpoint(debugger, chip8);
+
+        Chip8Status status = debugger_step(debugger, chip8);
+        if (CHIP8_IS_FAULT(status) || status == CHIP8_BREAKPOINT)
+            return status;
+
+        if (stop_mask & CHIP8_STOP_ON(status))
+            return status;
+    }
+
+    return CHIP8_OK;
+}
+
+/*
+ * Execute one instruction, running a whole subroutine if it is a CALL
+ */
+Chip8Status debugger_step_over(Debugger *debugger, Chip8 *chip8)
+{
+    uint16_t opcode = (chip8_read(chip8, chip8->PC) << 8) | chip8_read(chip8, chip8->PC + 1);
+    if ((opcode & 0xF000) != 0x2000)
+        return debugger_step(debugger, chip8);
+
+    // Run until the call returns to this stack depth
+    uint8_t depth = chip8->SP;
+    for (unsigned int i = 0; i < STEP_OVER_LIMIT; i++)
+    {
+        if (i > 0 && is_breakpoint(debugger, chip8->PC))
+            return hit_breakpoint(debugger, chip8);
+
+        Chip8Status status = debugger_step(debugger, chip8);
+        if (CHIP8_IS_FAULT(status) || status == CHIP8_BREAKPOINT || chip8->SP == depth)
+            return status;
+    }
+
+    printf("Step over did not return after %d instructions\n", STEP_OVER_LIMIT);
+    return CHIP8_BREAKPOINT;
+}
+
+/*
+ * Print the registers, timers and the instruction at PC
+ */
+void debugger_print_state(const Chip8 *chip8, FILE *out)
+{
+    fprintf(out, "PC=0x%03X I=0x%03X SP=%u DT=%u ST=%u cycle=%llu\n",
+            chip8->PC, chip8->I, chip8->SP, chip8->delay_timer, chip8->sound_timer,
+            (unsigned long long)chip8->cycles);
+
+    for (int x = 0; x < NUM_REGISTERS; x++)
+    {
+        fprintf(out, "V%X=%02X%c", x, chip8->V[x], x == NUM_REGISTERS - 1 ? '\n' : ' ');
+    }
+
+    debugger_print_disassembly(chip8, chip8->PC, 1, out);
+}
+
+/*
+ * Print count instructions of memory starting at start
+ */
+void debugger_print_disassembly(const Chip8 *chip8, uint16_t start, int count, FILE *out)
+{
+    char text[DISASM_MAX_LENGTH];
+
+    for (int i = 0; i < count; i++)
+    {
+        uint16_t address = (start + 2 * i) & RAM_MASK;
+        uint16_t opcode = (chip8_read(chip8, address) << 8) | chip8_read(chip8, address + 1);
+
+        chip8_disassemble(opcode, text, sizeof(text));
+        fprintf(out, "  0x%03X: %04X  %s\n", address, opcode, text);
+    }
+}
@@ -0,0 +1,48 @@
+#ifndef DEBUGGER_H
+#define DEBUGGER_H
+
+#include <stdio.h>
+#include "chip8.h"
+
+#define MAX_WATCHPOINTS 16
+
+// Upper bound on instructions run by a single step-over
+#define STEP_OVER_LIMIT 1000000
+
+typedef struct Debugger_t Debugger;
+
+struct Debugger_t
+{
+    // One bit per guest address
+    uint8_t breakpoints[TOTAL_RAM / 8];
+    int num_breakpoints;
+
+    // Memory watchpoints and the values last seen at them
+    uint16_t watch_addresses[MAX_WATCHPOINTS];
+    uint8_t watch_values[MAX_WATCHPOINTS];
+    int num_watchpoints;
+
+    // Register watchpoints, one bit per V register
+    uint16_t register_watches;
+    uint8_t register_values[NUM_REGISTERS];
+
+    // Set when stopped at a breakpoint, so the next run does not stop there again
+    bool resuming;
+};
+
+void debugger_init(Debugger *debugger);
+bool debugger_is_active(const Debugger *debugger);
+void debugger_add_breakpoint(Debugger *debugger, uint16_t address);
+void debugger_remove_breakpoint(Debugger *debugger, uint16_t address);
+bool debugger_add_watchpoint(Debugger *debugger, const Chip8 *chip8, uint16_t address);
+void debugger_watch_register(Debugger *debugger, const Chip8 *chip8, uint8_t x);
+
+Chip8Status debugger_run(Debugger *debugger, Chip8 *chip8, unsigned int max_cycles,
+                         unsigned int stop_mask);
+Chip8Status debugger_step(Debugger *debugger, Chip8 *chip8);
+Chip8Status debugger_step_over(Debugger *debugger, Chip8 *chip8);
+
+void debugger_print_state(const Chip8 *chip8, FILE *out);
+void debugger_print_disassembly(const Chip8 *chip8, uint16_t start, int count, FILE *out);
+
+#endif // DEBUGGER_H
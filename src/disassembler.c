@@ -0,0 +1,171 @@
+#include "disassembler.h"
+
+#include <stdio.h>
+
+/*
+ * Check whether an opcode is one chip8_cycle executes rather than faulting on
+ */
+bool chip8_is_valid_opcode(uint16_t opcode)
+{
+    switch (opcode & 0xF000)
+    {
+    case 0x0000:
+        return opcode == 0x00E0 || opcode == 0x00EE;
+    case 0x8000:
+        return (opcode & 0x000F) <= 0x7 || (opcode & 0x000F) == 0xE;
+    case 0xE000:
+        return (opcode & 0x00FF) == 0x9E || (opcode & 0x00FF) == 0xA1;
+    case 0xF000:
+        switch (opcode & 0x00FF)
+        {
+        case 0x07: case 0x0A: case 0x15: case 0x18: case 0x1E:
+        case 0x29: case 0x33: case 0x55: case 0x65:
+            return true;
+        default:
+            return false;
+        }
+    default:
+        return true;
+    }
+}
+
+/*
+ * Write the mnemonic for an opcode into buffer, using the syntax from
+ * Cowgod's technical reference. Unknown opcodes are shown as data.
+ */
+void chip8_disassemble(uint16_t opcode, char *buffer, size_t size)
+{
+    unsigned int x = (opcode & 0x0F00) >> 8;
+    unsigned int y = (opcode & 0x00F0) >> 4;
+    unsigned int n = opcode & 0x000F;
+    unsigned int kk = opcode & 0x00FF;
+    unsigned int nnn = opcode & 0x0FFF;
+
+    switch (opcode & 0xF000)
+    {
+    case 0x0000:
+        if (opcode == 0x00E0)
+        {
+            snprintf(buffer, size, "CLS");
+            return;
+        }
+        if (opcode == 0x00EE)
+        {
+            snprintf(buffer, size, "RET");
+            return;
+        }
+        break;
+
+    case 0x1000:
+        snprintf(buffer, size, "JP 0x%03X", nnn);
+        return;
+
+    case 0x2000:
+        snprintf(buffer, size, "CALL 0x%03X", nnn);
+        return;
+
+    case 0x3000:
+        snprintf(buffer, size, "SE V%X, 0x%02X", x, kk);
+        return;
+
+    case 0x4000:
+        snprintf(buffer, size, "SNE V%X, 0x%02X", x, kk);
+        return;
+
+    case 0x5000:
+        snprintf(buffer, size, "SE V%X, V%X", x, y);
+        return;
+
+    case 0x6000:
+        snprintf(buffer, size, "LD V%X, 0x%02X", x, kk);
+        return;
+
+    case 0x7000:
+        snprintf(buffer, size, "ADD V%X, 0x%02X", x, kk);
+        return;
+
+    case 0x8000:
+    {
+        static const char *const ALU_OPS[16] = {
+            "LD", "OR", "AND", "XOR", "ADD", "SUB", "SHR", "SUBN",
+            NULL, NULL, NULL, NULL, NULL, NULL, "SHL", NULL};
+
+        if (ALU_OPS[n] == NULL)
+            break;
+
+        if (n == 0x6 || n == 0xE)
+            snprintf(buffer, size, "%s V%X", ALU_OPS[n], x);
+        else
+            snprintf(buffer, size, "%s V%X, V%X", ALU_OPS[n], x, y);
+        return;
+    }
+
+    case 0x9000:
+        snprintf(buffer, size, "SNE V%X, V%X", x, y);
+        return;
+
+    case 0xA000:
+        snprintf(buffer, size, "LD I, 0x%03X", nnn);
+        return;
+
+    case 0xB000:
+        snprintf(buffer, size, "JP V0, 0x%03X", nnn);
+        return;
+
+    case 0xC000:
+        snprintf(buffer, size, "RND V%X, 0x%02X", x, kk);
+        return;
+
+    case 0xD000:
+        snprintf(buffer, size, "DRW V%X, V%X, %u", x, y, n);
+        return;
+
+    case 0xE000:
+        if (kk == 0x9E)
+        {
+            snprintf(buffer, size, "SKP V%X", x);
+            return;
+        }
+        if (kk == 0xA1)
+        {
+            snprintf(buffer, size, "SKNP V%X", x);
+            return;
+        }
+        break;
+
+    case 0xF000:
+        switch (kk)
+        {
+        case 0x07:
+            snprintf(buffer, size, "LD V%X, DT", x);
+            return;
+        case 0x0A:
+            snprintf(buffer, size, "LD V%X, K", x);
+            return;
+        case 0x15:
+            snprintf(buffer, size, "LD DT, V%X", x);
+            return;
+        case 0x18:
+            snprintf(buffer, size, "LD ST, V%X", x);
+            return;
+        case 0x1E:
+            snprintf(buffer, size, "ADD I, V%X", x);
+            return;
+        case 0x29:
+            snprintf(buffer, size, "LD F, V%X", x);
+            return;
+        case 0x33:
+            snprintf(buffer, size, "LD B, V%X", x);
+            return;
+        case 0x55:
+            snprintf(buffer, size, "LD [I], V%X", x);
+            return;
+        case 0x65:
+            snprintf(buffer, size, "LD V%X, [I]", x);
+            return;
+        }
+        break;
+    }
+
+    snprintf(buffer, size, "DW 0x%04X", opcode);
+}
@@ -0,0 +1,14 @@
+#ifndef DISASSEMBLER_H
+#define DISASSEMBLER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Longest mnemonic produced, including the terminator
+#define DISASM_MAX_LENGTH 24
+
+bool chip8_is_valid_opcode(uint16_t opcode);
+void chip8_disassemble(uint16_t opcode, char *buffer, size_t size);
+
+#endif // DISASSEMBLER_H
@@ -0,0 +1,210 @@
+#include "governor.h"
+#include "chip8.h"
+#include "metrics.h"
+
+#include <SDL2/SDL.h>
+#include <string.h>
+
+// Bounds for the spin margin, in microseconds
+#define MIN_SPIN_US 250
+#define MAX_SPIN_US 4000
+
+static uint64_t micros_to_ticks(const Governor *governor, uint64_t micros)
+{
+    return governor->frequency * micros / 1000000;
+}
+
+static double ticks_to_seconds(const Governor *governor, uint64_t ticks)
+{
+    return (double)ticks / governor->frequency;
+}
+
+static void start_window(Governor *governor, uint64_t now)
+{
+    governor->window_start = now;
+    governor->window_cycles = governor->cycles;
+    governor->window_frames = 0;
+    governor->window_presented = 0;
+    governor->window_dropped = 0;
+    governor->window_late_sum = 0;
+    governor->window_late_max = 0;
+}
+
+/*
+ * Pace emulation at hz instructions per second, or not at all with
+ * GOVERNOR_UNPACED. An emulated frame always lasts 1 / TIMER_HZ; the machine
+ * runs hz / TIMER_HZ instructions in it, as set by chip8_set_clock.
+ */
+void governor_init(Governor *governor, unsigned int hz)
+{
+    memset(governor, 0, sizeof(*governor));
+
+    uint64_t now = SDL_GetPerformanceCounter();
+    governor->hz = hz;
+    governor->frequency = SDL_GetPerformanceFrequency();
+    governor->frame_ticks = hz == GOVERNOR_UNPACED ? 0 : governor->frequency / TIMER_HZ;
+    governor->present_ticks = governor->frequency / GOVERNOR_PRESENT_HZ;
+    governor->spin_ticks = micros_to_ticks(governor, 1000);
+    governor->deadline = now + governor->frame_ticks;
+    governor->last_wake = now;
+    governor->next_present = governor->deadline;
+    start_window(governor, now);
+}
+
+/*
+ * Called after an emulated frame. Returns whether it should be presented:
+ * not while catching up on a late schedule, unless too many frames in a row
+ * have been dropped, and never faster than GOVERNOR_PRESENT_HZ.
+ */
+bool governor_end_frame(Governor *governor)
+{
+    uint64_t now = SDL_GetPerformanceCounter();
+
+    // Without a schedule, frames are shown by the clock
+    if (governor->hz == GOVERNOR_UNPACED)
+    {
+        if (now < governor->next_present)
+            return false;
+
+        governor->next_present = now + governor->present_ticks;
+        governor->window_presented++;
+        governor->total_presented++;
+        return true;
+    }
+
+    bool behind = now > governor->deadline + governor->frame_ticks;
+    if (behind && governor->dropped_in_row < GOVERNOR_MAX_DROPPED)
+    {
+        governor->dropped_in_row++;
+        governor->window_dropped++;
+        governor->total_dropped++;
+        return false;
+    }
+
+    // Faster than real time, frames in between are simply not shown. Going by
+    // the schedule rather than the clock keeps jitter from skipping frames.
+    if (!behind && governor->deadline < governor->next_present)
+        return false;
+
+    governor->dropped_in_row = 0;
+    governor->next_present += governor->present_ticks;
+    if (governor->next_present < governor->deadline)
+        governor->next_present = governor->deadline;
+    governor->window_presented++;
+    governor->total_presented++;
+    return true;
+}
+
+/*
+ * Sleep until close to the deadline, then spin the rest of the way. The spin
+ * margin follows how far the host oversleeps, so a loaded or coarse-timer host
+ * spins longer and an idle one sleeps longer.
+ */
+static void sleep_until(Governor *governor, uint64_t deadline)
+{
+    uint64_t now = SDL_GetPerformanceCounter();
+
+    if (deadline > now + governor->spin_ticks)
+    {
+        uint64_t sleep_ticks = deadline - now - governor->spin_ticks;
+        uint32_t sleep_ms = sleep_ticks * 1000 / governor->frequency;
+
+        if (sleep_ms > 0)
+        {
+            SDL_Delay(sleep_ms);
+
+            uint64_t woke = SDL_GetPerformanceCounter();
+            uint64_t requested = governor->frequency * sleep_ms / 1000;
+            uint64_t overshoot = woke - now > requested ? woke - now - requested : 0;
+
+            // Grow at once after a late wakeup, shrink slowly after punctual ones
+            if (overshoot > governor->spin_ticks)
+                governor->spin_ticks = overshoot;
+            else
+                governor->spin_ticks -= (governor->spin_ticks - overshoot) / 16;
+
+            uint64_t min_spin = micros_to_ticks(governor, MIN_SPIN_US);
+            uint64_t max_spin = micros_to_ticks(governor, MAX_SPIN_US);
+            if (governor->spin_ticks < min_spin)
+                governor->spin_ticks = min_spin;
+            if (governor->spin_ticks > max_spin)
+                governor->spin_ticks = max_spin;
+        }
+    }
+
+    while (SDL_GetPerformanceCounter() < deadline)
+        ;
+}
+
+/*
+ * Wait for the end of the current frame and record how late it ended.
+ * cycles is the machine's cycle count, used for the instruction rate.
+ */
+void governor_wait(Governor *governor, uint64_t cycles)
+{
+    uint64_t now = SDL_GetPerformanceCounter();
+    if (governor->hz == GOVERNOR_UNPACED)
+        governor->deadline = now;
+
+    // After a stall, such as a dragged window, catching up would run flat out
+    if (now > governor->deadline + micros_to_ticks(governor, GOVERNOR_RESYNC_SECONDS * 1000000))
+    {
+        governor->deadline = now;
+        governor->resyncs++;
+    }
+
+    sleep_until(governor, governor->deadline);
+
+    now = SDL_GetPerformanceCounter();
+    double late = ticks_to_seconds(governor, now - governor->deadline);
+    metrics_observe_frame_time(ticks_to_seconds(governor, now - governor->last_wake));
+    governor->last_wake = now;
+
+    governor->cycles = cycles;
+    governor->window_frames++;
+    governor->window_late_sum += late;
+    if (late > governor->window_late_max)
+        governor->window_late_max = late;
+    governor->total_frames++;
+    governor->total_late_sum += late;
+
+    governor->deadline += governor->frame_ticks;
+}
+
+/*
+ * Print the achieved rates and drift once interval seconds have passed since
+ * the last report. Returns whether a report was printed.
+ */
+bool governor_report(Governor *governor, double interval, FILE *stream)
+{
+    uint64_t now = SDL_GetPerformanceCounter();
+    double elapsed = ticks_to_seconds(governor, now - governor->window_start);
+    if (elapsed < interval || governor->window_frames == 0)
+        return false;
+
+    double target_fps = governor->hz == GOVERNOR_UNPACED ? 0 : TIMER_HZ;
+    fprintf(stream,
+            "%.1f frames/s (target %.1f), %.0f instructions/s (target %u), "
+            "%.1f presented/s, %u dropped, drift mean %.3f ms max %.3f ms, spin %.3f ms\n",
+            governor->window_frames / elapsed, target_fps,
+            (governor->cycles - governor->window_cycles) / elapsed, governor->hz,
+            governor->window_presented / elapsed, governor->window_dropped,
+            governor->window_late_sum / governor->window_frames * 1000,
+            governor->window_late_max * 1000,
+            ticks_to_seconds(governor, governor->spin_ticks) * 1000);
+
+    start_window(governor, now);
+    return true;
+}
+
+void governor_print_summary(const Governor *governor, FILE *stream)
+{
+    if (governor->total_frames == 0)
+        return;
+
+    fprintf(stream, "%llu frames, %llu presented, %llu dropped, %u resyncs, mean drift %.3f ms\n",
+            (unsigned long long)governor->total_frames,
+            (unsigned long long)governor->total_presented,
+            (unsigned long long)governor->total_dropped, governor->resyncs,
+            governor->total_late_sum / governor->total_frames * 1000);
+}
@@ -0,0 +1,66 @@
+#ifndef GOVERNOR_H
+#define GOVERNOR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Default instruction rate, CYCLES_PER_FRAME instructions per 60 Hz frame
+#define GOVERNOR_DEFAULT_HZ 600
+
+// Run as fast as the host allows, e.g. for scripted soak tests
+#define GOVERNOR_UNPACED 0
+
+// Presentation never exceeds this rate, however fast the emulation runs
+#define GOVERNOR_PRESENT_HZ 60
+
+// At most this many presentations in a row are dropped while catching up
+#define GOVERNOR_MAX_DROPPED 5
+
+// Falling further behind than this, e.g. after a stall, restarts the schedule
+#define GOVERNOR_RESYNC_SECONDS 0.25
+
+typedef struct Governor_t Governor;
+
+/*
+ * Paces emulation against the host clock. Each emulated frame has a deadline;
+ * the governor sleeps until shortly before it and spins for the rest. When
+ * the host cannot keep up, presentation is dropped so emulation keeps pace.
+ */
+struct Governor_t
+{
+    unsigned int hz;
+    uint64_t frequency;     // Performance counter ticks per second
+    uint64_t frame_ticks;   // Ticks per emulated frame
+    uint64_t present_ticks; // Minimum ticks between presented frames
+    uint64_t deadline;      // When the current frame should end
+    uint64_t next_present;  // Earliest deadline at which the next frame is shown
+    uint64_t spin_ticks;    // How early sleeping stops, adapted to sleep overshoot
+    unsigned int dropped_in_row;
+    uint64_t cycles;        // Machine cycle count after the last frame
+    uint64_t last_wake;     // When the previous frame's wait ended
+
+    // Statistics since the last report
+    uint64_t window_start;
+    uint64_t window_cycles;
+    unsigned int window_frames;
+    unsigned int window_presented;
+    unsigned int window_dropped;
+    double window_late_sum; // Seconds past the deadline, summed over frames
+    double window_late_max;
+
+    // Totals since governor_init
+    uint64_t total_frames;
+    uint64_t total_presented;
+    uint64_t total_dropped;
+    double total_late_sum;
+    unsigned int resyncs;
+};
+
+void governor_init(Governor *governor, unsigned int hz);
+bool governor_end_frame(Governor *governor);
+void governor_wait(Governor *governor, uint64_t cycles);
+bool governor_report(Governor *governor, double interval, FILE *stream);
+void governor_print_summary(const Governor *governor, FILE *stream);
+
+#endif // GOVERNOR_H
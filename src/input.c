@@ -0,0 +1,264 @@
+#include "input.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Keypad keys by physical key position on the left of a QWERTY keyboard
+static const SDL_Scancode DEFAULT_KEYS[NUM_KEYS] =
+    {
+        SDL_SCANCODE_X, // 0
+        SDL_SCANCODE_1, // 1
+        SDL_SCANCODE_2, // 2
+        SDL_SCANCODE_3, // 3
+        SDL_SCANCODE_Q, // 4
+        SDL_SCANCODE_W, // 5
+        SDL_SCANCODE_E, // 6
+        SDL_SCANCODE_A, // 7
+        SDL_SCANCODE_S, // 8
+        SDL_SCANCODE_D, // 9
+        SDL_SCANCODE_Z, // A
+        SDL_SCANCODE_C, // B
+        SDL_SCANCODE_4, // C
+        SDL_SCANCODE_R, // D
+        SDL_SCANCODE_F, // E
+        SDL_SCANCODE_V  // F
+};
+
+/*
+ * Default keymap: the keyboard layout above, and the D-pad on the keys
+ * around 5, which is pressed with A
+ */
+void keymap_init(Keymap *keymap)
+{
+    memset(keymap, KEYMAP_UNMAPPED, sizeof(*keymap));
+
+    for (int key = 0; key < NUM_KEYS; key++)
+    {
+        keymap->keys[DEFAULT_KEYS[key]] = key;
+    }
+
+    keymap->buttons[SDL_CONTROLLER_BUTTON_DPAD_UP] = 0x2;
+    keymap->buttons[SDL_CONTROLLER_BUTTON_DPAD_LEFT] = 0x4;
+    keymap->buttons[SDL_CONTROLLER_BUTTON_DPAD_RIGHT] = 0x6;
+    keymap->buttons[SDL_CONTROLLER_BUTTON_DPAD_DOWN] = 0x8;
+    keymap->buttons[SDL_CONTROLLER_BUTTON_A] = 0x5;
+    keymap->buttons[SDL_CONTROLLER_BUTTON_B] = 0x0;
+}
+
+/*
+ * Strip a line's trailing whitespace and return it without leading whitespace.
+ * Blank lines and comments, starting with '#', come back empty.
+ */
+static char *trim_line(char *line)
+{
+    size_t length = strlen(line);
+    while (length > 0 && isspace((unsigned char)line[length - 1]))
+        line[--length] = '\0';
+
+    while (isspace((unsigned char)*line))
+        line++;
+
+    if (*line == '#')
+        *line = '\0';
+    return line;
+}
+
+/*
+ * Replace the keymap with one read from a file. Each line maps a keypad key,
+ * in hex, to an SDL scancode name or, prefixed with "pad:", a controller
+ * button name:
+ *
+ *     5 W
+ *     5 Keypad 5
+ *     5 pad:a
+ *
+ * A key may have several lines. Nothing is changed if the file has an error.
+ */
+bool keymap_load(Keymap *keymap, const char *filename)
+{
+    FILE *file = fopen(filename, "r");
+    if (file == NULL)
+    {
+        perror("Failed to open keymap");
+        return false;
+    }
+
+    Keymap loaded;
+    memset(&loaded, KEYMAP_UNMAPPED, sizeof(loaded));
+
+    char buffer[256];
+    int line_number = 0;
+    bool valid = true;
+    while (valid && fgets(buffer, sizeof(buffer), file))
+    {
+        line_number++;
+        char *line = trim_line(buffer);
+        if (*line == '\0')
+            continue;
+
+        char *name;
+        unsigned long key = strtoul(line, &name, 16);
+        valid = name != line && key < NUM_KEYS && isspace((unsigned char)*name);
+        while (valid && isspace((unsigned char)*name))
+            name++;
+
+        if (valid && strncmp(name, "pad:", 4) == 0)
+        {
+            SDL_GameControllerButton button = SDL_GameControllerGetButtonFromString(name + 4);
+            valid = button != SDL_CONTROLLER_BUTTON_INVALID;
+            if (valid)
+                loaded.buttons[button] = key;
+        }
+        else if (valid)
+        {
+            SDL_Scancode scancode = SDL_GetScancodeFromName(name);
+            valid = scancode != SDL_SCANCODE_UNKNOWN;
+            if (valid)
+                loaded.keys[scancode] = key;
+        }
+    }
+    fclose(file);
+
+    if (!valid)
+    {
+        printf("Invalid mapping on line %d of %s\n", line_number, filename);
+        return false;
+    }
+
+    *keymap = loaded;
+    return true;
+}
+
+/*
+ * Read a script of keypad events. Each line gives a cycle count and what
+ * happens when the machine reaches it, in cycle order:
+ *
+ *     600 5 down
+ *     660 5 up
+ *     36000 quit
+ *
+ * Replaces any script loaded before, so script must start zeroed.
+ */
+bool script_load(InputScript *script, const char *filename)
+{
+    script_free(script);
+
+    FILE *file = fopen(filename, "r");
+    if (file == NULL)
+    {
+        perror("Failed to open input script");
+        return false;
+    }
+
+    size_t capacity = 0;
+    char buffer[256];
+    int line_number = 0;
+    bool valid = true;
+    while (valid && fgets(buffer, sizeof(buffer), file))
+    {
+        line_number++;
+        char *line = trim_line(buffer);
+        if (*line == '\0')
+            continue;
+
+        unsigned long long cycle;
+        char target[16], state[16];
+        int fields = sscanf(line, "%llu %15s %15s", &cycle, target, state);
+
+        ScriptEvent event = {cycle, SCRIPT_QUIT, 0};
+        if (fields == 2)
+        {
+            valid = strcmp(target, "quit") == 0;
+        }
+        else if (fields == 3)
+        {
+            char *endptr;
+            unsigned long key = strtoul(target, &endptr, 16);
+            event.key = key;
+            event.action = strcmp(state, "down") == 0 ? SCRIPT_KEY_DOWN : SCRIPT_KEY_UP;
+            valid = *endptr == '\0' && key < NUM_KEYS &&
+                    (strcmp(state, "down") == 0 || strcmp(state, "up") == 0);
+        }
+        else
+        {
+            valid = false;
+        }
+
+        if (valid && script->num_events > 0 && cycle < script->events[script->num_events - 1].cycle)
+            valid = false;
+        if (!valid)
+            break;
+
+        if (script->num_events == capacity)
+        {
+            capacity = capacity ? capacity * 2 : 64;
+            ScriptEvent *events = realloc(script->events, capacity * sizeof(ScriptEvent));
+            if (events == NULL)
+            {
+                perror("Failed to allocate input script");
+                fclose(file);
+                script_free(script);
+                return false;
+            }
+            script->events = events;
+        }
+        script->events[script->num_events++] = event;
+    }
+    fclose(file);
+
+    if (!valid)
+    {
+        printf("Invalid event on line %d of %s\n", line_number, filename);
+        script_free(script);
+        return false;
+    }
+
+    return true;
+}
+
+/*
+ * Apply every event due at or before the machine's cycle count
+ */
+void script_apply(InputScript *script, Chip8 *chip8)
+{
+    while (script->next < script->num_events && script->events[script->next].cycle <= chip8->cycles)
+    {
+        const ScriptEvent *event = &script->events[script->next++];
+        if (event->action == SCRIPT_QUIT)
+            chip8->is_running = false;
+        else
+            chip8->keypad[event->key] = event->action == SCRIPT_KEY_DOWN;
+    }
+}
+
+/*
+ * Run to the next frame boundary like chip8_run, stopping on the way at
+ * each event so it lands on its exact cycle
+ */
+Chip8Status script_run_frame(InputScript *script, Chip8 *chip8)
+{
+    Chip8Status status;
+    do
+    {
+        script_apply(script, chip8);
+        if (!chip8->is_running)
+            return CHIP8_OK;
+
+        unsigned int max_cycles = chip8->cycles_per_frame;
+        if (script->next < script->num_events &&
+            script->events[script->next].cycle - chip8->cycles < max_cycles)
+            max_cycles = script->events[script->next].cycle - chip8->cycles;
+
+        status = chip8_run(chip8, max_cycles, CHIP8_STOP_ON(CHIP8_FRAME));
+    } while (status == CHIP8_OK);
+
+    return status;
+}
+
+void script_free(InputScript *script)
+{
+    free(script->events);
+    memset(script, 0, sizeof(*script));
+}
@@ -0,0 +1,59 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <SDL2/SDL.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "chip8.h"
+
+// Marks a scancode or button that drives no keypad key
+#define KEYMAP_UNMAPPED (-1)
+
+typedef struct Keymap_t Keymap;
+typedef struct ScriptEvent_t ScriptEvent;
+typedef struct InputScript_t InputScript;
+
+/*
+ * Keypad key for every keyboard scancode and controller button, so an event
+ * is looked up rather than searched for
+ */
+struct Keymap_t
+{
+    int8_t keys[SDL_NUM_SCANCODES];
+    int8_t buttons[SDL_CONTROLLER_BUTTON_MAX];
+};
+
+typedef enum ScriptAction_t
+{
+    SCRIPT_KEY_DOWN,
+    SCRIPT_KEY_UP,
+    SCRIPT_QUIT,
+} ScriptAction;
+
+struct ScriptEvent_t
+{
+    uint64_t cycle; // Applied before the instruction at this cycle count runs
+    ScriptAction action;
+    uint8_t key;
+};
+
+/*
+ * Keypad input read from a file, in cycle order
+ */
+struct InputScript_t
+{
+    ScriptEvent *events;
+    size_t num_events;
+    size_t next;
+};
+
+void keymap_init(Keymap *keymap);
+bool keymap_load(Keymap *keymap, const char *filename);
+
+bool script_load(InputScript *script, const char *filename);
+void script_apply(InputScript *script, Chip8 *chip8);
+Chip8Status script_run_frame(InputScript *script, Chip8 *chip8);
+void script_free(InputScript *script);
+
+#endif // INPUT_H
@@ -1,8 +1,15 @@
 #include "instructions.h"
 
-#include <stdlib.h>
 #include <string.h>
 
+// Expanded at compile time, so LD B, Vx is a lookup instead of two divisions
+#define BCD(n) {(n) / 100, (n) / 10 % 10, (n) % 10}
+#define BCD_4(n) BCD(n), BCD((n) + 1), BCD((n) + 2), BCD((n) + 3)
+#define BCD_16(n) BCD_4(n), BCD_4((n) + 4), BCD_4((n) + 8), BCD_4((n) + 12)
+#define BCD_64(n) BCD_16(n), BCD_16((n) + 16), BCD_16((n) + 32), BCD_16((n) + 48)
+
+const uint8_t BCD_TABLE[256][3] = {BCD_64(0), BCD_64(64), BCD_64(128), BCD_64(192)};
+
 /*
  * Opcode 00E0: CLS
  * Clear the display by setting all pixels to 'off'.
@@ -19,7 +26,7 @@ void op_0x00E0(Chip8 *chip8)
 void op_0x00EE(Chip8 *chip8)
 {
     chip8->SP--;
-    chip8->PC = chip8->stack[chip8->SP];
+    chip8->PC = chip8->stack[chip8->SP & STACK_MASK];
 }
 
 /*
@@ -39,7 +46,7 @@ void op_0x1NNN(Chip8 *chip8)
 void op_0x2NNN(Chip8 *chip8)
 {
     uint16_t address = chip8->current_op & 0x0FFF;
-    chip8->stack[chip8->SP] = chip8->PC;
+    chip8->stack[chip8->SP & STACK_MASK] = chip8->PC;
     chip8->SP++;
     chip8->PC = address;
 }
@@ -138,7 +145,7 @@ void op_0x8XY2(Chip8 *chip8)
 {
     uint8_t x = (chip8->current_op & 0x0F00) >> 8;
     uint8_t y = (chip8->current_op & 0x00F0) >> 4;
-    chip8->V[x] = chip8->V[x] | chip8->V[y];
+    chip8->V[x] = chip8->V[x] & chip8->V[y];
 }
 
 /*
@@ -213,7 +220,7 @@ void op_0x8XY7(Chip8 *chip8)
 void op_0x8XYE(Chip8 *chip8)
 {
     uint8_t x = (chip8->current_op & 0x0F00) >> 8;
-    chip8->V[0xF] = chip8->V[x] & 0x80;
+    chip8->V[0xF] = chip8->V[x] >> 7;
     chip8->V[x] <<= 1;
 }
 
@@ -259,7 +266,15 @@ void op_0xCXKK(Chip8 *chip8)
 {
     uint8_t x = (chip8->current_op & 0x0F00) >> 8;
     uint8_t kk = chip8->current_op & 0x00FF;
-    uint8_t random_val = rand() % 256;
+
+    // Advance the instance's xorshift32 generator
+    uint32_t r = chip8->rng_state;
+    r ^= r << 13;
+    r ^= r >> 17;
+    r ^= r << 5;
+    chip8->rng_state = r;
+
+    uint8_t random_val = r & 0xFF;
     chip8->V[x] = random_val & kk;
 }
 
@@ -281,14 +296,23 @@ void op_0xDXYN(Chip8 *chip8)
     // Initialize collision register to false
     chip8->V[0xF] = 0;
 
-    // Loop through the n rows of the sprite
-    for (unsigned int row = 0; row < n; row++)
+    // Sprites are clipped at the bottom and right edges of the screen
+    unsigned int rows = n;
+    if (y_pos + rows > SCREEN_HEIGHT)
+        rows = SCREEN_HEIGHT - y_pos;
+
+    unsigned int cols = 8;
+    if (x_pos + cols > SCREEN_WIDTH)
+        cols = SCREEN_WIDTH - x_pos;
+
+    // Loop through the visible rows of the sprite
+    for (unsigned int row = 0; row < rows; row++)
     {
         // Get the nth byte of sprite data
-        uint8_t spriteByte = chip8->memory[chip8->I + row];
+        uint8_t spriteByte = chip8_read(chip8, chip8->I + row);
 
-        // Go through each pixel in the sprite row
-        for (unsigned int col = 0; col < 8; col++)
+        // Go through each visible pixel in the sprite row
+        for (unsigned int col = 0; col < cols; col++)
         {
             uint8_t sprite_pixel = spriteByte & (0x80 >> col);
 
@@ -316,7 +340,7 @@ void op_0xDXYN(Chip8 *chip8)
 void op_0xEX9E(Chip8 *chip8)
 {
     uint8_t x = (chip8->current_op & 0x0F00) >> 8;
-    uint8_t key = chip8->V[x];
+    uint8_t key = chip8->V[x] & 0xF;
     if (chip8->keypad[key])
     {
         chip8->PC += 2;
@@ -330,7 +354,7 @@ void op_0xEX9E(Chip8 *chip8)
 void op_0xEXA1(Chip8 *chip8)
 {
     uint8_t x = (chip8->current_op & 0x0F00) >> 8;
-    uint8_t key = chip8->V[x];
+    uint8_t key = chip8->V[x] & 0xF;
     if (!chip8->keypad[key])
     {
         chip8->PC += 2;
@@ -419,11 +443,7 @@ void op_0xFX29(Chip8 *chip8)
 void op_0xFX33(Chip8 *chip8)
 {
     uint8_t x = (chip8->current_op & 0x0F00) >> 8;
-    uint8_t val = chip8->V[x];
-
-    chip8->memory[chip8->I] = val / 100;
-    chip8->memory[chip8->I + 1] = val / 10 % 10;
-    chip8->memory[chip8->I + 2] = val % 10;
+    chip8_write_block(chip8, chip8->I, BCD_TABLE[chip8->V[x]], 3);
 }
 
 /*
@@ -433,11 +453,7 @@ void op_0xFX33(Chip8 *chip8)
 void op_0xFX55(Chip8 *chip8)
 {
     uint8_t x = (chip8->current_op & 0x0F00) >> 8;
-
-    for (int i = 0; i <= x; i++)
-    {
-        chip8->memory[chip8->I + i] = chip8->V[i];
-    }
+    chip8_write_block(chip8, chip8->I, chip8->V, x + 1);
 }
 
 /*
@@ -447,9 +463,5 @@ void op_0xFX55(Chip8 *chip8)
 void op_0xFX65(Chip8 *chip8)
 {
     uint8_t x = (chip8->current_op & 0x0F00) >> 8;
-
-    for (int i = 0; i <= x; i++)
-    {
-        chip8->V[i] = chip8->memory[chip8->I + i];
-    }
+    chip8_read_block(chip8, chip8->I, chip8->V, x + 1);
 }
\ No newline at end of file
@@ -3,6 +3,9 @@
 
 #include "chip8.h"
 
+// Hundreds, tens and ones digits of every byte value, for LD B, Vx
+extern const uint8_t BCD_TABLE[256][3];
+
 // CLS
 void op_0x00E0(Chip8 *chip8);
 
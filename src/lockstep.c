@@ -0,0 +1,529 @@
+#include "lockstep.h"
+#include "metrics.h"
+#include "trace.h"
+
+#include <string.h>
+
+void lockstep_init(Lockstep *lockstep)
+{
+    memset(lockstep, 0, sizeof(*lockstep));
+    lockstep->fault_lane = -1;
+}
+
+/*
+ * Add a machine as a new lane. Every lane must have executed the same number
+ * of cycles at the same clock so their timers tick together.
+ */
+bool lockstep_add(Lockstep *lockstep, Chip8 *chip8)
+{
+    if (lockstep->num_lanes == LOCKSTEP_LANES)
+        return false;
+
+    const Chip8 *first = lockstep->machines[0];
+    if (lockstep->num_lanes > 0 &&
+        (chip8->cycles != lockstep->cycles || chip8->next_frame != first->next_frame ||
+         chip8->cycles_per_frame != first->cycles_per_frame))
+        return false;
+
+    lockstep->cycles = chip8->cycles;
+    lockstep->machines[lockstep->num_lanes++] = chip8;
+    return true;
+}
+
+/*
+ * Drop a lane, typically one that faulted. The last lane takes its place.
+ */
+void lockstep_remove(Lockstep *lockstep, int lane)
+{
+    lockstep->machines[lane] = lockstep->machines[--lockstep->num_lanes];
+}
+
+/*
+ * Copy a machine's hot registers into its lane
+ */
+static void gather(Lockstep *lockstep, int lane)
+{
+    const Chip8 *chip8 = lockstep->machines[lane];
+
+    for (int x = 0; x < NUM_REGISTERS; x++)
+    {
+        lockstep->V[x][lane] = chip8->V[x];
+    }
+    lockstep->I[lane] = chip8->I;
+    lockstep->PC[lane] = chip8->PC;
+    lockstep->delay_timer[lane] = chip8->delay_timer;
+    lockstep->sound_timer[lane] = chip8->sound_timer;
+}
+
+/*
+ * Copy a lane's registers back into its machine
+ */
+static void scatter(Lockstep *lockstep, int lane)
+{
+    Chip8 *chip8 = lockstep->machines[lane];
+
+    for (int x = 0; x < NUM_REGISTERS; x++)
+    {
+        chip8->V[x] = lockstep->V[x][lane];
+    }
+    chip8->I = lockstep->I[lane];
+    chip8->PC = lockstep->PC[lane];
+    chip8->delay_timer = lockstep->delay_timer[lane];
+    chip8->sound_timer = lockstep->sound_timer[lane];
+}
+
+static uint16_t fetch(Lockstep *lockstep, int lane)
+{
+    const Chip8 *chip8 = lockstep->machines[lane];
+    uint16_t pc = lockstep->PC[lane];
+    return (chip8_read(chip8, pc) << 8) | chip8_read(chip8, pc + 1);
+}
+
+/*
+ * Execute one register-only opcode across every lane at once.
+ * Returns false if the opcode needs the scalar interpreter.
+ *
+ * Each loop runs over all LOCKSTEP_LANES columns, including unused ones,
+ * so the compiler can turn it into fixed-width vector code.
+ */
+static bool vector_execute(Lockstep *lockstep, uint16_t opcode)
+{
+    uint8_t x = (opcode & 0x0F00) >> 8;
+    uint8_t y = (opcode & 0x00F0) >> 4;
+    uint8_t kk = opcode & 0x00FF;
+    uint16_t nnn = opcode & 0x0FFF;
+
+    uint8_t *vx = lockstep->V[x];
+    uint8_t *vy = lockstep->V[y];
+    uint8_t *vf = lockstep->V[0xF];
+    uint16_t *pc = lockstep->PC;
+    int l;
+
+    switch (opcode & 0xF000)
+    {
+    case 0x1000:
+        // JP
+        for (l = 0; l < LOCKSTEP_LANES; l++)
+            pc[l] = nnn;
+        return true;
+
+    case 0x3000:
+        // SE Vx, byte
+        for (l = 0; l < LOCKSTEP_LANES; l++)
+            pc[l] += vx[l] == kk ? 4 : 2;
+        return true;
+
+    case 0x4000:
+        // SNE Vx, byte
+        for (l = 0; l < LOCKSTEP_LANES; l++)
+            pc[l] += vx[l] != kk ? 4 : 2;
+        return true;
+
+    case 0x5000:
+        // SE Vx, Vy
+        for (l = 0; l < LOCKSTEP_LANES; l++)
+            pc[l] += vx[l] == vy[l] ? 4 : 2;
+        return true;
+
+    case 0x6000:
+        // LD Vx, byte
+        for (l = 0; l < LOCKSTEP_LANES; l++)
+            vx[l] = kk;
+        break;
+
+    case 0x7000:
+        // ADD Vx, byte
+        for (l = 0; l < LOCKSTEP_LANES; l++)
+            vx[l] += kk;
+        break;
+
+    case 0x8000:
+        // Per lane, flags are written before Vx exactly as the handlers do
+        switch (opcode & 0x000F)
+        {
+        case 0x0000:
+            for (l = 0; l < LOCKSTEP_LANES; l++)
+                vx[l] = vy[l];
+            break;
+        case 0x0001:
+            for (l = 0; l < LOCKSTEP_LANES; l++)
+                vx[l] |= vy[l];
+            break;
+        case 0x0002:
+            for (l = 0; l < LOCKSTEP_LANES; l++)
+                vx[l] &= vy[l];
+            break;
+        case 0x0003:
+            for (l = 0; l < LOCKSTEP_LANES; l++)
+                vx[l] ^= vy[l];
+            break;
+        case 0x0004:
+            for (l = 0; l < LOCKSTEP_LANES; l++)
+            {
+                uint16_t sum = vx[l] + vy[l];
+                vf[l] = sum > 255;
+                vx[l] = sum & 0xFF;
+            }
+            break;
+        case 0x0005:
+            for (l = 0; l < LOCKSTEP_LANES; l++)
+            {
+                vf[l] = vx[l] > vy[l];
+                vx[l] -= vy[l];
+            }
+            break;
+        case 0x0006:
+            for (l = 0; l < LOCKSTEP_LANES; l++)
+            {
+                vf[l] = vx[l] & 1;
+                vx[l] >>= 1;
+            }
+            break;
+        case 0x0007:
+            for (l = 0; l < LOCKSTEP_LANES; l++)
+            {
+                vf[l] = vy[l] > vx[l];
+                vx[l] = vy[l] - vx[l];
+            }
+            break;
+        case 0x000E:
+            for (l = 0; l < LOCKSTEP_LANES; l++)
+            {
+                vf[l] = vx[l] >> 7;
+                vx[l] <<= 1;
+            }
+            break;
+        default:
+            return false;
+        }
+        break;
+
+    case 0x9000:
+        // SNE Vx, Vy
+        for (l = 0; l < LOCKSTEP_LANES; l++)
+            pc[l] += vx[l] != vy[l] ? 4 : 2;
+        return true;
+
+    case 0xA000:
+        // LD I, addr
+        for (l = 0; l < LOCKSTEP_LANES; l++)
+            lockstep->I[l] = nnn;
+        break;
+
+    case 0xF000:
+        switch (kk)
+        {
+        case 0x07:
+            for (l = 0; l < LOCKSTEP_LANES; l++)
+                vx[l] = lockstep->delay_timer[l];
+            break;
+        case 0x15:
+            for (l = 0; l < LOCKSTEP_LANES; l++)
+                lockstep->delay_timer[l] = vx[l];
+            break;
+        case 0x18:
+            for (l = 0; l < LOCKSTEP_LANES; l++)
+                lockstep->sound_timer[l] = vx[l];
+            break;
+        case 0x1E:
+            for (l = 0; l < LOCKSTEP_LANES; l++)
+                lockstep->I[l] += vx[l];
+            break;
+        case 0x29:
+            for (l = 0; l < LOCKSTEP_LANES; l++)
+                lockstep->I[l] = 0x5 * vx[l];
+            break;
+        default:
+            return false;
+        }
+        break;
+
+    default:
+        return false;
+    }
+
+    for (l = 0; l < LOCKSTEP_LANES; l++)
+        pc[l] += 2;
+    return true;
+}
+
+/*
+ * Record a cycle executed by the vector path and tick the lane timers on
+ * frame boundaries. Detached lanes' columns are ticked too, but they are
+ * never scattered back.
+ */
+static void end_vector_cycle(Lockstep *lockstep, uint16_t opcode, const int group[], int group_size,
+                             const uint16_t addresses[])
+{
+    METRICS_ADD(instructions[opcode >> 12], group_size);
+
+    // Without tracing the group and addresses go unused
+    uint8_t x = (opcode & 0x0F00) >> 8;
+    for (int g = 0; TRACE_ENABLED && g < group_size; g++)
+    {
+        TRACE_RECORD(addresses[group[g]], opcode, lockstep->I[group[g]], lockstep->V[x][group[g]],
+                     lockstep->V[0xF][group[g]]);
+    }
+    (void)group;
+    (void)addresses;
+    (void)x;
+
+    if (lockstep->cycles + 1 != lockstep->next_frame)
+        return;
+
+    lockstep->next_frame += lockstep->cycles_per_frame;
+
+    for (int l = 0; l < LOCKSTEP_LANES; l++)
+    {
+        lockstep->delay_timer[l] -= lockstep->delay_timer[l] > 0;
+        lockstep->sound_timer[l] -= lockstep->sound_timer[l] > 0;
+    }
+}
+
+/*
+ * Write a lane back to its machine as it leaves the group, with the cycles
+ * and last opcode the vector path ran for it
+ */
+static void leave_group(Lockstep *lockstep, int lane, unsigned int vector_cycles, uint16_t last_op,
+                        unsigned int cycles_run)
+{
+    scatter(lockstep, lane);
+
+    Chip8 *chip8 = lockstep->machines[lane];
+    chip8->cycles += vector_cycles;
+    if (vector_cycles > 0)
+        chip8->next_frame = lockstep->next_frame;
+    if (cycles_run > 0)
+        chip8->current_op = last_op;
+}
+
+/*
+ * Pick the more common of the first value and the first one that differs
+ * from it, such as the opcode most of the group is about to execute.
+ * Returns it and how many times it occurs.
+ */
+static uint16_t most_common(const uint16_t values[], int count, int *occurrences)
+{
+    uint16_t leader = values[0];
+    int matching = 0;
+    int other = -1;
+    for (int v = 0; v < count; v++)
+    {
+        if (values[v] == leader)
+            matching++;
+        else if (other < 0)
+            other = v;
+    }
+
+    *occurrences = matching;
+    if (other < 0 || matching * 2 > count)
+        return leader;
+
+    int other_matching = 0;
+    for (int v = other; v < count; v++)
+    {
+        other_matching += values[v] == values[other];
+    }
+
+    if (other_matching <= matching)
+        return leader;
+
+    *occurrences = other_matching;
+    return values[other];
+}
+
+/*
+ * Whether at least half the lanes are at the same address, and so worth
+ * gathering to step together
+ */
+static bool can_regroup(const Lockstep *lockstep)
+{
+    uint16_t addresses[LOCKSTEP_LANES];
+    for (int lane = 0; lane < lockstep->num_lanes; lane++)
+    {
+        addresses[lane] = lockstep->machines[lane]->PC;
+    }
+
+    int matching;
+    most_common(addresses, lockstep->num_lanes, &matching);
+    return matching * 2 >= lockstep->num_lanes;
+}
+
+/*
+ * Run a lane's machine on its own through chip8_run, noting the first fault
+ */
+static void run_lane(Lockstep *lockstep, int lane, unsigned int cycles, Chip8Status *status)
+{
+    Chip8Status lane_status = chip8_run(lockstep->machines[lane], cycles, 0);
+    if (CHIP8_IS_FAULT(lane_status) && lockstep->fault_lane < 0)
+    {
+        *status = lane_status;
+        lockstep->fault_lane = lane;
+    }
+}
+
+/*
+ * Step the lanes together for up to max_cycles, with their registers gathered
+ * into the lane columns. Register-only instructions execute once across the
+ * group, anything else steps each lane in it through chip8_run. A lane that
+ * fetches a different opcode from the rest leaves the group and, once the
+ * group stops, catches up on its own in one chip8_run batch. Returns the
+ * cycles run, stopping early on a fault or once fewer than half the lanes
+ * are left in the group.
+ */
+static unsigned int run_grouped(Lockstep *lockstep, unsigned int max_cycles, Chip8Status *status)
+{
+    int num_lanes = lockstep->num_lanes;
+    int group[LOCKSTEP_LANES];
+    int group_size = num_lanes;
+    unsigned int detached_at[LOCKSTEP_LANES];
+
+    for (int lane = 0; lane < num_lanes; lane++)
+    {
+        gather(lockstep, lane);
+        group[lane] = lane;
+        detached_at[lane] = max_cycles;
+    }
+    lockstep->next_frame = lockstep->machines[0]->next_frame;
+    lockstep->cycles_per_frame = lockstep->machines[0]->cycles_per_frame;
+
+    // Vector cycles not yet added to the machines in the group, which is done
+    // as they leave it or before they step through chip8_run
+    unsigned int vector_cycles = 0;
+    uint16_t last_op = 0;
+
+    unsigned int i = 0;
+    for (; i < max_cycles && lockstep->fault_lane < 0; i++)
+    {
+        uint16_t addresses[LOCKSTEP_LANES];
+        if (TRACE_ENABLED)
+            memcpy(addresses, lockstep->PC, sizeof(addresses));
+
+        uint16_t opcode = fetch(lockstep, group[0]);
+        bool uniform = true;
+        if (group_size == num_lanes)
+        {
+            // Until a lane leaves, the group is every lane in order
+            for (int lane = 1; lane < num_lanes && uniform; lane++)
+                uniform = fetch(lockstep, lane) == opcode;
+        }
+        else
+        {
+            for (int g = 1; g < group_size && uniform; g++)
+                uniform = fetch(lockstep, group[g]) == opcode;
+        }
+
+        if (!uniform)
+        {
+            uint16_t opcodes[LOCKSTEP_LANES];
+            for (int g = 0; g < group_size; g++)
+            {
+                opcodes[g] = fetch(lockstep, group[g]);
+            }
+            int matching;
+            opcode = most_common(opcodes, group_size, &matching);
+
+            // Lanes leaving the group keep their registers in their machines;
+            // the vector loops go on writing their columns regardless
+            int kept = 0;
+            for (int g = 0; g < group_size; g++)
+            {
+                if (opcodes[g] == opcode)
+                {
+                    group[kept++] = group[g];
+                    continue;
+                }
+
+                leave_group(lockstep, group[g], vector_cycles, last_op, i);
+                detached_at[group[g]] = i;
+            }
+            group_size = matching;
+
+            if (group_size * 2 < num_lanes)
+            {
+                lockstep->diverged_cycles = LOCKSTEP_DIVERGED_CYCLES;
+                break;
+            }
+        }
+
+        if (vector_execute(lockstep, opcode))
+        {
+            end_vector_cycle(lockstep, opcode, group, group_size, addresses);
+            vector_cycles++;
+        }
+        else
+        {
+            // chip8_run ticks the timers by the machine's own cycle count
+            for (int g = 0; g < group_size; g++)
+            {
+                Chip8 *chip8 = lockstep->machines[group[g]];
+                scatter(lockstep, group[g]);
+                chip8->cycles += vector_cycles;
+                chip8->next_frame = lockstep->next_frame;
+                run_lane(lockstep, group[g], 1, status);
+                gather(lockstep, group[g]);
+            }
+            lockstep->next_frame = lockstep->machines[group[0]]->next_frame;
+            vector_cycles = 0;
+        }
+
+        last_op = opcode;
+        lockstep->cycles++;
+    }
+
+    for (int g = 0; g < group_size; g++)
+    {
+        leave_group(lockstep, group[g], vector_cycles, last_op, i);
+    }
+
+    // Lanes that left the group, or the rest of it after a divergence, catch up
+    // to where it stopped
+    for (int lane = 0; lane < num_lanes; lane++)
+    {
+        if (detached_at[lane] < i)
+            run_lane(lockstep, lane, i - detached_at[lane], status);
+    }
+
+    return i;
+}
+
+/*
+ * Run every lane for up to max_cycles instructions, together while at least
+ * half the lanes fetch the same opcode. Once most have diverged, the lanes
+ * run on their own for whole calls until LOCKSTEP_DIVERGED_CYCLES have
+ * passed, and then regroup if half of them are at the same address. Stops
+ * after the batch in which a lane faults, with fault_lane set; that lane
+ * should then be removed.
+ */
+Chip8Status lockstep_run(Lockstep *lockstep, unsigned int max_cycles)
+{
+    Chip8Status status = CHIP8_OK;
+    lockstep->fault_lane = -1;
+
+    unsigned int i = 0;
+    while (i < max_cycles && lockstep->num_lanes > 0 && lockstep->fault_lane < 0)
+    {
+        if (lockstep->diverged_cycles == 0 && can_regroup(lockstep))
+        {
+            i += run_grouped(lockstep, max_cycles - i, &status);
+            continue;
+        }
+
+        if (lockstep->diverged_cycles == 0)
+            lockstep->diverged_cycles = LOCKSTEP_DIVERGED_CYCLES;
+
+        // Diverged lanes keep their registers in their machines and run to
+        // the end of the call in one go
+        unsigned int cycles = max_cycles - i;
+        for (int lane = 0; lane < lockstep->num_lanes; lane++)
+        {
+            run_lane(lockstep, lane, cycles, &status);
+        }
+
+        lockstep->cycles += cycles;
+        lockstep->diverged_cycles -= cycles < lockstep->diverged_cycles ? cycles : lockstep->diverged_cycles;
+        i += cycles;
+    }
+
+    return status;
+}
@@ -0,0 +1,42 @@
+#ifndef LOCKSTEP_H
+#define LOCKSTEP_H
+
+#include "chip8.h"
+
+// Lanes per group; loops over lanes have this fixed trip count so they vectorize
+#define LOCKSTEP_LANES 16
+
+// Cycles each lane runs alone once most of the group diverges, before trying to regroup
+#define LOCKSTEP_DIVERGED_CYCLES 64
+
+typedef struct Lockstep_t Lockstep;
+
+/*
+ * A group of machines, typically running the same ROM, stepped together.
+ * While the lanes run together the hot registers live here in structure-of-arrays
+ * form, one column per lane; memory, stack and screen stay in each Chip8.
+ */
+struct Lockstep_t
+{
+    Chip8 *machines[LOCKSTEP_LANES];
+    int num_lanes;
+
+    uint8_t V[NUM_REGISTERS][LOCKSTEP_LANES];
+    uint16_t I[LOCKSTEP_LANES];
+    uint16_t PC[LOCKSTEP_LANES];
+    uint8_t delay_timer[LOCKSTEP_LANES];
+    uint8_t sound_timer[LOCKSTEP_LANES];
+    uint64_t cycles; // Shared by every lane
+    uint64_t next_frame; // Shared by the lanes while they run as a group
+    unsigned int cycles_per_frame;
+    unsigned int diverged_cycles; // Cycles the lanes still run alone before regrouping
+
+    int fault_lane; // Lane that stopped the last run, or -1
+};
+
+void lockstep_init(Lockstep *lockstep);
+bool lockstep_add(Lockstep *lockstep, Chip8 *chip8);
+void lockstep_remove(Lockstep *lockstep, int lane);
+Chip8Status lockstep_run(Lockstep *lockstep, unsigned int max_cycles);
+
+#endif // LOCKSTEP_H
@@ -1,16 +1,91 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
 #include "chip8.h"
+#include "debugger.h"
+#include "governor.h"
+#include "metrics.h"
 #include "platform.h"
+#include "trace.h"
+
+/*
+ * Parse a hexadecimal address or register number, with or without a 0x prefix
+ */
+static bool parse_hex(const char *text, unsigned long max, uint16_t *value)
+{
+    char *endptr;
+    unsigned long parsed = strtoul(text, &endptr, 16);
+    if (*text == '\0' || *endptr != '\0' || parsed > max)
+        return false;
+
+    *value = parsed;
+    return true;
+}
+
+typedef struct RomLoader_t RomLoader;
+
+/*
+ * A ROM loaded on its own thread while SDL brings up the window
+ */
+struct RomLoader_t
+{
+    Chip8 *chip8;
+    const char *filename;
+    bool loaded;
+    uint64_t start;
+    uint64_t end;
+};
+
+static int load_rom(void *data)
+{
+    RomLoader *loader = data;
+    loader->start = SDL_GetPerformanceCounter();
+
+    chip8_init(loader->chip8);
+    chip8_seed(loader->chip8, (uint32_t)time(NULL));
+    loader->loaded = chip8_load_rom(loader->chip8, loader->filename);
+
+    loader->end = SDL_GetPerformanceCounter();
+    return 0;
+}
+
+static void print_phase(const char *name, uint64_t start, uint64_t from, uint64_t to, FILE *out)
+{
+    double ms_per_tick = 1000.0 / SDL_GetPerformanceFrequency();
+    fprintf(out, "  %-20s %9.2f %9.2f %9.2f\n", name, (from - start) * ms_per_tick,
+            (to - start) * ms_per_tick, (to - from) * ms_per_tick);
+}
+
+/*
+ * Print when each startup phase began and ended, in milliseconds since main
+ * was entered. The ROM loads alongside the video and window phases; the
+ * options phase includes waiting for it.
+ */
+static void print_startup_report(uint64_t start, const RomLoader *loader, uint64_t options_parsed,
+                                 const PlatformTimes *times, FILE *out)
+{
+    fprintf(out, "Startup (ms)              start       end     taken\n");
+    print_phase("SDL video", start, start, times->video, out);
+    print_phase("window", start, times->video, times->window, out);
+    print_phase("ROM load (thread)", start, loader->start, loader->end, out);
+    print_phase("options", start, times->window, options_parsed, out);
+    print_phase("renderer", start, options_parsed, times->renderer, out);
+    print_phase("first frame", start, times->renderer, times->first_present, out);
+    print_phase("controllers", start, times->first_present, times->controllers, out);
+}
 
 int main(int argc, char *argv[])
 {
+    uint64_t start = SDL_GetPerformanceCounter();
+
     // Validate and process arguments
-    if (argc != 3)
+    if (argc < 3)
     {
-        printf("Usage: %s <scale> <rom>\n", argv[0]);
+        printf("Usage: %s <scale> <rom> [--hz <n>|max] [--stats] [--time-startup] [--keymap <file>] [--script <file>] "
+               "[--metrics <file>] [--trace <file>] [--break <addr>] [--watch <addr>] "
+               "[--watch-reg <x>]\n", argv[0]);
         return 1;
     }
 
@@ -22,34 +97,206 @@ int main(int argc, char *argv[])
         return 1;
     }
 
-    const char *rom_filename = argv[2];
-
-    // Seed the RNG
-    srand(time(NULL));
+    // Initialize the emulator and load the ROM while the window is set up,
+    // or before it if no thread can be started
+    Chip8 chip8;
+    RomLoader loader = {&chip8, argv[2], false, 0, 0};
+    SDL_Thread *loader_thread = SDL_CreateThread(load_rom, "rom loader", &loader);
+    if (loader_thread == NULL)
+        load_rom(&loader);
 
-    // Set up the window
     Platform platform;
-    if (!platform_init(&platform, SCREEN_WIDTH * screenScale, SCREEN_HEIGHT * screenScale))
+    bool window_ready = platform_init(&platform, SCREEN_WIDTH * screenScale, SCREEN_HEIGHT * screenScale);
+    SDL_WaitThread(loader_thread, NULL);
+    if (!window_ready || !loader.loaded)
+    {
+        chip8_release(&chip8);
+        platform_cleanup(&platform);
         return 1;
+    }
 
-    // Initialize the emulator and load ROM into memory
-    Chip8 chip8;
-    chip8_init(&chip8);
-    chip8_load_rom(&chip8, rom_filename);
+    // Speed, breakpoints and watchpoints are given after the ROM
+    Debugger debugger;
+    debugger_init(&debugger);
+    unsigned int hz = GOVERNOR_DEFAULT_HZ;
+    bool print_stats = false;
+    bool time_startup = false;
+    const char *metrics_filename = NULL;
+    InputScript script = {0};
+    for (int i = 3; i < argc; i++)
+    {
+        const char *option = argv[i];
+        bool is_register = strcmp(option, "--watch-reg") == 0;
+        bool valid = i + 1 < argc;
+
+        if (strcmp(option, "--stats") == 0)
+        {
+            print_stats = true;
+            continue;
+        }
+
+        if (strcmp(option, "--time-startup") == 0)
+        {
+            time_startup = true;
+            continue;
+        }
+
+        if (strcmp(option, "--metrics") == 0)
+        {
+            valid = valid && metrics_init(argv[++i]);
+            if (valid)
+                metrics_filename = argv[i];
+        }
+        else if (strcmp(option, "--trace") == 0)
+        {
+            valid = valid && trace_init(argv[++i], TRACE_DEFAULT_ENTRIES);
+        }
+        else if (strcmp(option, "--keymap") == 0)
+        {
+            valid = valid && keymap_load(&platform.keymap, argv[++i]);
+        }
+        else if (strcmp(option, "--script") == 0)
+        {
+            valid = valid && script_load(&script, argv[++i]);
+        }
+        else if (strcmp(option, "--hz") == 0 && valid && strcmp(argv[i + 1], "max") == 0)
+        {
+            hz = GOVERNOR_UNPACED;
+            i++;
+        }
+        else if (strcmp(option, "--hz") == 0)
+        {
+            if (valid)
+                hz = strtoul(argv[++i], &endptr, 10);
+            valid = valid && *endptr == '\0' && hz > 0;
+        }
+        else
+        {
+            uint16_t value;
+            valid = valid && parse_hex(argv[++i], is_register ? NUM_REGISTERS - 1 : RAM_MASK, &value);
+
+            if (valid && strcmp(option, "--break") == 0)
+                debugger_add_breakpoint(&debugger, value);
+            else if (valid && strcmp(option, "--watch") == 0)
+                valid = debugger_add_watchpoint(&debugger, &chip8, value);
+            else if (valid && is_register)
+                debugger_watch_register(&debugger, &chip8, value);
+            else
+                valid = false;
+        }
+
+        if (!valid)
+        {
+            printf("Invalid option: %s\n", option);
+            script_free(&script);
+            chip8_release(&chip8);
+            platform_cleanup(&platform);
+            return 1;
+        }
+    }
+
+    uint64_t options_parsed = SDL_GetPerformanceCounter();
+    if (!platform_init_renderer(&platform))
+    {
+        script_free(&script);
+        chip8_release(&chip8);
+        platform_cleanup(&platform);
+        return 1;
+    }
 
     int pitch = sizeof(chip8.screen[0]) * SCREEN_WIDTH;
 
+    // --hz sets the CPU clock; the timers and the governor's frames stay at 60 Hz
+    if (hz != GOVERNOR_UNPACED)
+        hz = chip8_set_clock(&chip8, hz);
+
+    Governor governor;
+    governor_init(&governor, hz);
+    uint32_t metrics_written = SDL_GetTicks();
+
     // Main loop
+    int exit_code = 0;
     while (chip8.is_running)
     {
-        platform_process_input(&chip8);
+        platform_process_input(&platform, &chip8);
+
+        Chip8Status status = CHIP8_OK;
+        if (chip8.is_paused)
+        {
+            // Execute only what the user asked for, and show where it stopped
+            if (chip8.step_requested || chip8.step_over_requested)
+            {
+                status = chip8.step_over_requested ? debugger_step_over(&debugger, &chip8)
+                                                   : debugger_step(&debugger, &chip8);
+                debugger_print_state(&chip8, stdout);
+            }
 
-        chip8_cycle(&chip8);
-        platform_update(&platform, &chip8, pitch);
+            chip8.step_requested = false;
+            chip8.step_over_requested = false;
+        }
+        else if (debugger_is_active(&debugger))
+        {
+            // Checked dispatch, only used when breakpoints or watchpoints are set;
+            // scripted input lands at the start of the frame
+            script_apply(&script, &chip8);
+            status = debugger_run(&debugger, &chip8, chip8.cycles_per_frame, CHIP8_STOP_ON(CHIP8_FRAME));
+            if (status == CHIP8_BREAKPOINT)
+            {
+                chip8.is_paused = true;
+                debugger_print_state(&chip8, stdout);
+            }
+        }
+        else if (script.num_events > 0)
+        {
+            status = script_run_frame(&script, &chip8);
+        }
+        else
+        {
+            // Run one frame of instructions, up to the next timer tick
+            status = chip8_run(&chip8, chip8.cycles_per_frame, CHIP8_STOP_ON(CHIP8_FRAME));
+        }
 
-        SDL_Delay(2);
+        if (CHIP8_IS_FAULT(status))
+        {
+            printf("Stopped: %s at 0x%03X (opcode 0x%04X)\n",
+                   chip8_status_string(status), chip8.fault_pc, chip8.current_op);
+            debugger_print_state(&chip8, stdout);
+            exit_code = 1;
+            break;
+        }
+
+        // Emulation keeps its pace; presentation is what gives way when the host is slow
+        if (governor_end_frame(&governor))
+        {
+            platform_update(&platform, &chip8, pitch);
+            if (time_startup)
+            {
+                print_startup_report(start, &loader, options_parsed, &platform.times, stdout);
+                time_startup = false;
+            }
+        }
+        else
+            METRICS_ADD(frames_skipped, 1);
+
+        governor_wait(&governor, chip8.cycles);
+        if (print_stats)
+            governor_report(&governor, 5.0, stdout);
+
+        metrics_flush();
+        if (metrics_filename && SDL_GetTicks() - metrics_written >= METRICS_INTERVAL_MS)
+        {
+            metrics_write_file(metrics_filename);
+            metrics_written = SDL_GetTicks();
+        }
     }
 
+    if (print_stats)
+        governor_print_summary(&governor, stdout);
+    if (metrics_filename)
+        metrics_write_file(metrics_filename);
+
+    script_free(&script);
+    chip8_release(&chip8);
     platform_cleanup(&platform);
-    return 0;
-}
\ No newline at end of file
+    return exit_code;
+}
@@ -0,0 +1,157 @@
+#include "metrics.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef CHIP8_METRICS
+
+_Thread_local Metrics metrics_local;
+
+static Metrics totals;
+
+static const char *const OPCODE_CLASSES[16] = {
+    "0NNN", "1NNN", "2NNN", "3XKK", "4XKK", "5XY0", "6XKK", "7XKK",
+    "8XYN", "9XY0", "ANNN", "BNNN", "CXKK", "DXYN", "EXKK", "FXKK"};
+
+static const double FRAME_BUCKETS_MS[METRICS_NUM_FRAME_BUCKETS] = METRICS_FRAME_BUCKETS_MS;
+
+void metrics_observe_frame_time(double seconds)
+{
+    double ms = seconds * 1000;
+    int bucket = 0;
+    while (bucket < METRICS_NUM_FRAME_BUCKETS && ms > FRAME_BUCKETS_MS[bucket])
+        bucket++;
+
+    metrics_local.frame_time_buckets[bucket]++;
+    metrics_local.frame_time_sum_us += seconds * 1000000;
+}
+
+/*
+ * Add this thread's counters to the totals and clear them. Call it at a
+ * convenient point, such as once per frame or when a thread finishes.
+ */
+void metrics_flush(void)
+{
+    const uint64_t *local = (const uint64_t *)&metrics_local;
+    uint64_t *total = (uint64_t *)&totals;
+
+    for (size_t i = 0; i < sizeof(Metrics) / sizeof(uint64_t); i++)
+    {
+        if (local[i] != 0)
+            __atomic_fetch_add(&total[i], local[i], __ATOMIC_RELAXED);
+    }
+
+    memset(&metrics_local, 0, sizeof(metrics_local));
+}
+
+static uint64_t load(const uint64_t *counter)
+{
+    return __atomic_load_n(counter, __ATOMIC_RELAXED);
+}
+
+/*
+ * Write the totals in the Prometheus text format. The file is replaced
+ * atomically, so a collector never reads a partial one.
+ */
+bool metrics_write_file(const char *filename)
+{
+    char temp_filename[4096];
+    snprintf(temp_filename, sizeof(temp_filename), "%s.tmp", filename);
+
+    FILE *file = fopen(temp_filename, "w");
+    if (file == NULL)
+    {
+        perror("Failed to write metrics");
+        return false;
+    }
+
+    fprintf(file, "# HELP chip8_instructions_total Instructions executed, by opcode class.\n");
+    fprintf(file, "# TYPE chip8_instructions_total counter\n");
+    for (int c = 0; c < 16; c++)
+    {
+        fprintf(file, "chip8_instructions_total{class=\"%s\"} %llu\n", OPCODE_CLASSES[c],
+                (unsigned long long)load(&totals.instructions[c]));
+    }
+
+    fprintf(file, "# HELP chip8_draws_total DXYN instructions executed.\n");
+    fprintf(file, "# TYPE chip8_draws_total counter\n");
+    fprintf(file, "chip8_draws_total %llu\n", (unsigned long long)load(&totals.draws));
+
+    fprintf(file, "# HELP chip8_collisions_total DXYN instructions that set VF.\n");
+    fprintf(file, "# TYPE chip8_collisions_total counter\n");
+    fprintf(file, "chip8_collisions_total %llu\n", (unsigned long long)load(&totals.collisions));
+
+    fprintf(file, "# HELP chip8_key_wait_cycles_total Cycles spent blocked in FX0A.\n");
+    fprintf(file, "# TYPE chip8_key_wait_cycles_total counter\n");
+    fprintf(file, "chip8_key_wait_cycles_total %llu\n",
+            (unsigned long long)load(&totals.key_wait_cycles));
+
+    fprintf(file, "# HELP chip8_frames_total Emulated frames, by whether they were presented.\n");
+    fprintf(file, "# TYPE chip8_frames_total counter\n");
+    fprintf(file, "chip8_frames_total{result=\"presented\"} %llu\n",
+            (unsigned long long)load(&totals.frames_presented));
+    fprintf(file, "chip8_frames_total{result=\"skipped\"} %llu\n",
+            (unsigned long long)load(&totals.frames_skipped));
+
+    fprintf(file, "# HELP chip8_frame_seconds Wall time of each emulated frame.\n");
+    fprintf(file, "# TYPE chip8_frame_seconds histogram\n");
+    uint64_t cumulative = 0;
+    for (int b = 0; b <= METRICS_NUM_FRAME_BUCKETS; b++)
+    {
+        cumulative += load(&totals.frame_time_buckets[b]);
+        if (b < METRICS_NUM_FRAME_BUCKETS)
+            fprintf(file, "chip8_frame_seconds_bucket{le=\"%g\"} %llu\n", FRAME_BUCKETS_MS[b] / 1000,
+                    (unsigned long long)cumulative);
+        else
+            fprintf(file, "chip8_frame_seconds_bucket{le=\"+Inf\"} %llu\n",
+                    (unsigned long long)cumulative);
+    }
+    fprintf(file, "chip8_frame_seconds_sum %g\n", load(&totals.frame_time_sum_us) / 1e6);
+    fprintf(file, "chip8_frame_seconds_count %llu\n", (unsigned long long)cumulative);
+
+    bool written = fclose(file) == 0;
+    if (!written || rename(temp_filename, filename) != 0)
+    {
+        perror("Failed to write metrics");
+        remove(temp_filename);
+        return false;
+    }
+
+    return true;
+}
+
+/*
+ * Check that metrics can be written to filename by writing the empty
+ * totals there, so a bad path is reported before the run starts
+ */
+bool metrics_init(const char *filename)
+{
+    return metrics_write_file(filename);
+}
+
+#else
+
+bool metrics_init(const char *filename)
+{
+    (void)filename;
+    printf("Metrics are not compiled in; configure with -DCHIP8_METRICS=ON\n");
+    return false;
+}
+
+void metrics_observe_frame_time(double seconds)
+{
+    (void)seconds;
+}
+
+void metrics_flush(void)
+{
+}
+
+bool metrics_write_file(const char *filename)
+{
+    (void)filename;
+    printf("Metrics are not compiled in; configure with -DCHIP8_METRICS=ON\n");
+    return false;
+}
+
+#endif // CHIP8_METRICS
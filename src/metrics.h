@@ -0,0 +1,50 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Upper bounds of the frame time histogram buckets, in milliseconds
+#define METRICS_FRAME_BUCKETS_MS {1, 2, 4, 8, 12, 16, 17, 20, 25, 33, 50, 100}
+#define METRICS_NUM_FRAME_BUCKETS 12
+
+// How often the frontend rewrites its metrics file
+#define METRICS_INTERVAL_MS 5000
+
+typedef struct Metrics_t Metrics;
+
+/*
+ * Counters kept by each thread, and the totals they are flushed into.
+ * Instructions are counted by their first nibble.
+ */
+struct Metrics_t
+{
+    uint64_t instructions[16];
+    uint64_t draws;
+    uint64_t collisions;
+    uint64_t key_wait_cycles;
+    uint64_t frames_presented;
+    uint64_t frames_skipped;
+    uint64_t frame_time_buckets[METRICS_NUM_FRAME_BUCKETS + 1]; // Last bucket is +Inf
+    uint64_t frame_time_sum_us;
+};
+
+#ifdef CHIP8_METRICS
+
+extern _Thread_local Metrics metrics_local;
+
+// Plain increment of this thread's counter; totals only change in metrics_flush
+#define METRICS_ADD(field, n) (metrics_local.field += (n))
+
+#else
+
+#define METRICS_ADD(field, n) ((void)0)
+
+#endif // CHIP8_METRICS
+
+bool metrics_init(const char *filename);
+void metrics_observe_frame_time(double seconds);
+void metrics_flush(void);
+bool metrics_write_file(const char *filename);
+
+#endif // METRICS_H
@@ -0,0 +1,173 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "chip8.h"
+#include "governor.h"
+#include "platform.h"
+
+#define MAX_SESSIONS 16
+
+typedef struct Session_t Session;
+
+struct Session_t
+{
+    Chip8 *chip8;
+    const char *rom_filename;
+    bool stopped; // Faulted or quit; its last frame stays on screen
+};
+
+/*
+ * Copy every session's screen into its cell of the atlas, so the whole
+ * window is uploaded to the texture once per frame
+ */
+static void composite(uint32_t *atlas, int columns, const Session *sessions, int num_sessions)
+{
+    int atlas_width = columns * SCREEN_WIDTH;
+
+    for (int s = 0; s < num_sessions; s++)
+    {
+        uint32_t *cell = &atlas[(s / columns) * SCREEN_HEIGHT * atlas_width + (s % columns) * SCREEN_WIDTH];
+        for (int y = 0; y < SCREEN_HEIGHT; y++)
+        {
+            memcpy(&cell[y * atlas_width], &sessions[s].chip8->screen[y * SCREEN_WIDTH],
+                   SCREEN_WIDTH * sizeof(uint32_t));
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3)
+    {
+        printf("Usage: %s <scale> <rom>...\n", argv[0]);
+        return 1;
+    }
+
+    char *endptr;
+    int screenScale = strtol(argv[1], &endptr, 10);
+    if (*endptr != '\0')
+    {
+        printf("Invalid character in scale value: %c\n", *endptr);
+        return 1;
+    }
+
+    int num_sessions = argc - 2;
+    if (num_sessions > MAX_SESSIONS)
+    {
+        printf("At most %d ROMs can run at once\n", MAX_SESSIONS);
+        return 1;
+    }
+
+    // Lay the screens out in a grid as close to square as possible
+    int columns = 1;
+    while (columns * columns < num_sessions)
+        columns++;
+    int rows = (num_sessions + columns - 1) / columns;
+
+    int atlas_width = columns * SCREEN_WIDTH;
+    int atlas_height = rows * SCREEN_HEIGHT;
+    uint32_t *atlas = calloc(atlas_width * atlas_height, sizeof(uint32_t));
+    Chip8 *machines = aligned_alloc(_Alignof(Chip8), sizeof(Chip8) * num_sessions);
+    if (atlas == NULL || machines == NULL)
+    {
+        perror("Failed to allocate sessions");
+        free(machines);
+        free(atlas);
+        return 1;
+    }
+
+    // Every machine is set up before anything can fail, so every exit releases them all
+    Session sessions[MAX_SESSIONS];
+    Chip8 *inputs[MAX_SESSIONS];
+    for (int s = 0; s < num_sessions; s++)
+    {
+        sessions[s].chip8 = &machines[s];
+        sessions[s].rom_filename = argv[s + 2];
+        sessions[s].stopped = false;
+        inputs[s] = &machines[s];
+
+        chip8_init(&machines[s]);
+        chip8_seed(&machines[s], (uint32_t)time(NULL) + s);
+    }
+
+    // One window, renderer and texture shared by every session
+    Platform platform;
+    bool started = platform_init_atlas(&platform, atlas_width * screenScale, atlas_height * screenScale,
+                                       atlas_width, atlas_height);
+
+    // Every ROM that fails to load is reported, and then none of them run
+    bool loaded = true;
+    for (int s = 0; started && s < num_sessions; s++)
+    {
+        loaded = chip8_load_rom(&machines[s], sessions[s].rom_filename) && loaded;
+    }
+
+    // The window is already up; drawing only needs the renderer once the ROMs are in
+    started = started && loaded && platform_init_renderer(&platform);
+
+    Governor governor;
+    governor_init(&governor, GOVERNOR_DEFAULT_HZ);
+
+    int focus = 0;
+    int pitch = atlas_width * sizeof(uint32_t);
+    int running = started ? num_sessions : 0;
+
+    while (running > 0)
+    {
+        platform_process_input_multi(&platform, inputs, num_sessions, &focus);
+
+        // Stepping one frame of every session costs microseconds, so it stays on this thread
+        for (int s = 0; s < num_sessions; s++)
+        {
+            Session *session = &sessions[s];
+            if (session->stopped)
+                continue;
+
+            if (!session->chip8->is_running)
+            {
+                session->stopped = true;
+                running--;
+                continue;
+            }
+
+            if (session->chip8->is_paused)
+                continue;
+
+            Chip8Status status = chip8_run(session->chip8, session->chip8->cycles_per_frame, CHIP8_STOP_ON(CHIP8_FRAME));
+            if (CHIP8_IS_FAULT(status))
+            {
+                printf("%s stopped: %s at 0x%03X (opcode 0x%04X)\n", session->rom_filename,
+                       chip8_status_string(status), session->chip8->fault_pc,
+                       session->chip8->current_op);
+                session->stopped = true;
+                running--;
+            }
+        }
+
+        if (governor_end_frame(&governor))
+        {
+            composite(atlas, columns, sessions, num_sessions);
+
+            // Outline the session that has the keyboard
+            SDL_Rect highlight = {
+                (focus % columns) * SCREEN_WIDTH * screenScale,
+                (focus / columns) * SCREEN_HEIGHT * screenScale,
+                SCREEN_WIDTH * screenScale,
+                SCREEN_HEIGHT * screenScale};
+            platform_present(&platform, atlas, pitch, num_sessions > 1 ? &highlight : NULL);
+        }
+
+        governor_wait(&governor, sessions[0].chip8->cycles);
+    }
+
+    for (int s = 0; s < num_sessions; s++)
+    {
+        chip8_release(&machines[s]);
+    }
+    free(machines);
+    free(atlas);
+    platform_cleanup(&platform);
+    return started ? 0 : 1;
+}
@@ -1,14 +1,38 @@
 #include "platform.h"
+#include "metrics.h"
 #include <stdio.h>
+#include <string.h>
 
 bool platform_init(Platform *platform, int window_width, int window_height)
 {
+    return platform_init_atlas(platform, window_width, window_height, SCREEN_WIDTH, SCREEN_HEIGHT);
+}
+
+/*
+ * Open a window whose texture holds texture_width x texture_height pixels,
+ * e.g. several 64x32 screens laid out side by side. Only the window is
+ * created here, so it can be on screen while the ROM loads; the renderer
+ * comes from platform_init_renderer and controllers after the first frame.
+ */
+bool platform_init_atlas(Platform *platform, int window_width, int window_height,
+                         int texture_width, int texture_height)
+{
+    platform->window = NULL;
+    platform->renderer = NULL;
+    platform->texture = NULL;
+    platform->texture_width = texture_width;
+    platform->texture_height = texture_height;
+    platform->controllers_ready = false;
+    memset(&platform->times, 0, sizeof(platform->times));
+    keymap_init(&platform->keymap);
+
     // Initialize SDL video and event subsystems
     if (SDL_Init(SDL_INIT_VIDEO) < 0)
     {
         printf("Could not initialize SDL: %s\n", SDL_GetError());
         return false;
     }
+    platform->times.video = SDL_GetPerformanceCounter();
 
     platform->window = SDL_CreateWindow(
         "CHIP-8", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
@@ -18,7 +42,17 @@ bool platform_init(Platform *platform, int window_width, int window_height)
         printf("Could not create SDL window: %s\n", SDL_GetError());
         return false;
     }
+    platform->times.window = SDL_GetPerformanceCounter();
 
+    return true;
+}
+
+/*
+ * Create the renderer and streaming texture for the window. Deferred until
+ * the frontend has its ROMs, so a bad ROM or option never pays for it.
+ */
+bool platform_init_renderer(Platform *platform)
+{
     platform->renderer = SDL_CreateRenderer(platform->window, -1, SDL_RENDERER_ACCELERATED);
     if (!platform->renderer)
     {
@@ -28,86 +62,187 @@ bool platform_init(Platform *platform, int window_width, int window_height)
 
     platform->texture = SDL_CreateTexture(
         platform->renderer, SDL_PIXELFORMAT_RGBA8888,
-        SDL_TEXTUREACCESS_STREAMING, SCREEN_WIDTH, SCREEN_HEIGHT);
+        SDL_TEXTUREACCESS_STREAMING, platform->texture_width, platform->texture_height);
     if (!platform->texture)
     {
         printf("Could not create SDL texture: %s\n", SDL_GetError());
         return false;
     }
+    platform->times.renderer = SDL_GetPerformanceCounter();
 
     return true;
 }
 
+/*
+ * Bring up game controllers. Opening them can take a while, so it waits
+ * until the first frame is on screen; controllers already plugged in are
+ * then reported as added.
+ */
+static void init_controllers(Platform *platform)
+{
+    platform->controllers_ready = true;
+
+    // Controllers are optional; the keyboard works without them
+    if (SDL_InitSubSystem(SDL_INIT_GAMECONTROLLER) < 0)
+        printf("Game controllers unavailable: %s\n", SDL_GetError());
+    platform->times.controllers = SDL_GetPerformanceCounter();
+}
+
 void platform_update(Platform *platform, Chip8 *chip8, int pitch)
+{
+    platform_present(platform, chip8->screen, pitch, NULL);
+}
+
+/*
+ * Upload a whole frame to the texture in one go and show it, outlining the
+ * highlight rectangle, in window coordinates, if there is one
+ */
+void platform_present(Platform *platform, const uint32_t *pixels, int pitch, const SDL_Rect *highlight)
 {
     // Copy pixel buffer to SDL texture
-    SDL_UpdateTexture(platform->texture, NULL, chip8->screen, pitch);
+    SDL_UpdateTexture(platform->texture, NULL, pixels, pitch);
 
     // Render the texture
     SDL_RenderClear(platform->renderer);
     SDL_RenderCopy(platform->renderer, platform->texture, NULL, NULL);
+    if (highlight)
+    {
+        SDL_SetRenderDrawColor(platform->renderer, 0xFF, 0x80, 0x00, 0xFF);
+        SDL_RenderDrawRect(platform->renderer, highlight);
+        SDL_SetRenderDrawColor(platform->renderer, 0x00, 0x00, 0x00, 0xFF);
+    }
     SDL_RenderPresent(platform->renderer);
+    METRICS_ADD(frames_presented, 1);
+
+    if (!platform->controllers_ready)
+    {
+        platform->times.first_present = SDL_GetPerformanceCounter();
+        init_controllers(platform);
+    }
 }
 
-void platform_process_input(Chip8 *chip8)
+/*
+ * Apply one event to a machine: quit, pause, stepping and keypad state
+ */
+static void handle_event(const Keymap *keymap, Chip8 *chip8, const SDL_Event *e)
 {
-    SDL_Event e;
-    while (SDL_PollEvent(&e))
+    SDL_Scancode sc = e->key.keysym.scancode;
+
+    switch (e->type)
     {
-        SDL_Scancode sc = e.key.keysym.scancode;
+    // Checks for the close window button
+    case SDL_QUIT:
+        chip8->is_running = false;
+        break;
 
-        switch (e.type)
+    case SDL_KEYDOWN:
+        if (sc == SDL_SCANCODE_ESCAPE)
         {
-        // Checks for the close window button
-        case SDL_QUIT:
             chip8->is_running = false;
             break;
+        }
 
-        case SDL_KEYDOWN:
-            if (sc == SDL_SCANCODE_ESCAPE)
-            {
-                chip8->is_running = false;
-                break;
-            }
+        if (sc == SDL_SCANCODE_SPACE)
+        {
+            chip8->is_paused = !chip8->is_paused;
+            printf("Paused state: %d\n", chip8->is_paused);
+            break;
+        }
 
-            if (sc == SDL_SCANCODE_SPACE)
-            {
-                chip8->is_paused = !chip8->is_paused;
-                printf("Paused state: %d\n", chip8->is_paused);
-                break;
-            }
+        // Single stepping only applies while paused
+        if (sc == SDL_SCANCODE_F11 && chip8->is_paused)
+        {
+            chip8->step_requested = true;
+            break;
+        }
 
-            // Checks each key by physical key positions and updates keypad state
-            for (unsigned int i = 0; i < NUM_KEYS; i++)
-            {
-                if (sc == KEYMAP[i])
-                {
-                    chip8->keypad[i] = true;
-                }
-            }
+        if (sc == SDL_SCANCODE_F10 && chip8->is_paused)
+        {
+            chip8->step_over_requested = true;
             break;
+        }
+
+        if (keymap->keys[sc] != KEYMAP_UNMAPPED)
+            chip8->keypad[keymap->keys[sc]] = true;
+        break;
+
+    case SDL_KEYUP:
+        if (keymap->keys[sc] != KEYMAP_UNMAPPED)
+            chip8->keypad[keymap->keys[sc]] = false;
+        break;
+
+    // Controllers connected at startup are reported here too
+    case SDL_CONTROLLERDEVICEADDED:
+        if (SDL_GameControllerOpen(e->cdevice.which) == NULL)
+            printf("Could not open controller: %s\n", SDL_GetError());
+        break;
 
-        case SDL_KEYUP:
-            // Checks each key by physical key positions and updates keypad state
-            for (unsigned int i = 0; i < NUM_KEYS; i++)
+    case SDL_CONTROLLERDEVICEREMOVED:
+        SDL_GameControllerClose(SDL_GameControllerFromInstanceID(e->cdevice.which));
+        break;
+
+    case SDL_CONTROLLERBUTTONDOWN:
+    case SDL_CONTROLLERBUTTONUP:
+        if (e->cbutton.button < SDL_CONTROLLER_BUTTON_MAX &&
+            keymap->buttons[e->cbutton.button] != KEYMAP_UNMAPPED)
+            chip8->keypad[keymap->buttons[e->cbutton.button]] = e->type == SDL_CONTROLLERBUTTONDOWN;
+        break;
+
+    default:
+        break;
+    }
+}
+
+void platform_process_input(Platform *platform, Chip8 *chip8)
+{
+    SDL_Event e;
+    while (SDL_PollEvent(&e))
+    {
+        handle_event(&platform->keymap, chip8, &e);
+    }
+}
+
+/*
+ * Route input to the focused one of several machines. TAB moves the focus on,
+ * releasing the keys held on the machine losing it; quitting stops them all.
+ */
+void platform_process_input_multi(Platform *platform, Chip8 *const sessions[], int num_sessions,
+                                  int *focus)
+{
+    SDL_Event e;
+    while (SDL_PollEvent(&e))
+    {
+        SDL_Scancode sc = e.key.keysym.scancode;
+        bool quit = e.type == SDL_QUIT || (e.type == SDL_KEYDOWN && sc == SDL_SCANCODE_ESCAPE);
+
+        if (quit)
+        {
+            for (int s = 0; s < num_sessions; s++)
             {
-                if (sc == KEYMAP[i])
-                {
-                    chip8->keypad[i] = false;
-                }
+                sessions[s]->is_running = false;
             }
-            break;
+            continue;
+        }
 
-        default:
-            break;
+        if (e.type == SDL_KEYDOWN && sc == SDL_SCANCODE_TAB)
+        {
+            memset(sessions[*focus]->keypad, false, sizeof(sessions[*focus]->keypad));
+            *focus = (*focus + 1) % num_sessions;
+            continue;
         }
+
+        handle_event(&platform->keymap, sessions[*focus], &e);
     }
 }
 
 void platform_cleanup(Platform *platform)
 {
-    SDL_DestroyTexture(platform->texture);
-    SDL_DestroyRenderer(platform->renderer);
-    SDL_DestroyWindow(platform->window);
+    // Startup may have stopped before any of these were created
+    if (platform->texture)
+        SDL_DestroyTexture(platform->texture);
+    if (platform->renderer)
+        SDL_DestroyRenderer(platform->renderer);
+    if (platform->window)
+        SDL_DestroyWindow(platform->window);
     SDL_Quit();
 }
\ No newline at end of file
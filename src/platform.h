@@ -3,40 +3,46 @@
 
 #include <SDL2/SDL.h>
 #include "chip8.h"
+#include "input.h"
 
-static const uint8_t KEYMAP[NUM_KEYS] =
-    {
-        SDL_SCANCODE_X, // 0
-        SDL_SCANCODE_1, // 1
-        SDL_SCANCODE_2, // 2
-        SDL_SCANCODE_3, // 3
-        SDL_SCANCODE_Q, // 4
-        SDL_SCANCODE_W, // 5
-        SDL_SCANCODE_E, // 6
-        SDL_SCANCODE_A, // 7
-        SDL_SCANCODE_S, // 8
-        SDL_SCANCODE_D, // 9
-        SDL_SCANCODE_Z, // A
-        SDL_SCANCODE_C, // B
-        SDL_SCANCODE_4, // C
-        SDL_SCANCODE_R, // D
-        SDL_SCANCODE_F, // E
-        SDL_SCANCODE_V  // F
-};
-
+typedef struct PlatformTimes_t PlatformTimes;
 typedef struct Platform_t Platform;
 
+/*
+ * Performance counter readings taken as each part of the platform comes up,
+ * for reporting where startup time goes
+ */
+struct PlatformTimes_t
+{
+    uint64_t video;
+    uint64_t window;
+    uint64_t renderer;
+    uint64_t first_present;
+    uint64_t controllers;
+};
+
 struct Platform_t
 {
     SDL_Window *window;
     SDL_Renderer *renderer;
     SDL_Texture *texture;
+    int texture_width;
+    int texture_height;
+    bool controllers_ready;
     uint32_t pixels[SCREEN_WIDTH * SCREEN_HEIGHT];
+    Keymap keymap;
+    PlatformTimes times;
 };
 
 bool platform_init(Platform *platform, int window_width, int window_height);
+bool platform_init_atlas(Platform *platform, int window_width, int window_height,
+                         int texture_width, int texture_height);
+bool platform_init_renderer(Platform *platform);
 void platform_update(Platform *platform, Chip8 *chip8, int pitch);
-void platform_process_input(Chip8 *chip8);
+void platform_present(Platform *platform, const uint32_t *pixels, int pitch, const SDL_Rect *highlight);
+void platform_process_input(Platform *platform, Chip8 *chip8);
+void platform_process_input_multi(Platform *platform, Chip8 *const sessions[], int num_sessions,
+                                  int *focus);
 void platform_cleanup(Platform *platform);
 
 #endif // PLATFORM_H
\ No newline at end of file
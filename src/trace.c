@@ -0,0 +1,155 @@
+#include "trace.h"
+
+#include <stdio.h>
+
+#ifdef CHIP8_TRACE
+
+#include <fcntl.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+_Thread_local TraceRing *trace_ring;
+
+// The one ring being recorded, reachable from signal handlers on any thread
+static TraceRing ring;
+static char dump_filename[4096];
+
+static const int CRASH_SIGNALS[] = {SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT};
+
+static bool write_all(int fd, const void *data, size_t size)
+{
+    const char *bytes = data;
+    while (size > 0)
+    {
+        ssize_t written = write(fd, bytes, size);
+        if (written <= 0)
+            return false;
+
+        bytes += written;
+        size -= written;
+    }
+
+    return true;
+}
+
+/*
+ * Write the ring to the trace file, oldest entry first. Only uses
+ * async-signal-safe calls, so it can run from a signal handler.
+ */
+void trace_dump(void)
+{
+    if (ring.entries == NULL)
+        return;
+
+    int fd = open(dump_filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return;
+
+    uint64_t total = ring.total;
+    uint64_t capacity = (uint64_t)ring.mask + 1;
+    uint32_t count = total < capacity ? total : capacity;
+    uint32_t oldest = (total - count) & ring.mask;
+
+    TraceHeader header = {TRACE_MAGIC, TRACE_VERSION, count, total, ring.status, 0};
+    uint32_t first = count < capacity - oldest ? count : capacity - oldest;
+
+    if (write_all(fd, &header, sizeof(header)) &&
+        write_all(fd, &ring.entries[oldest], first * sizeof(TraceEntry)))
+        write_all(fd, ring.entries, (count - first) * sizeof(TraceEntry));
+    close(fd);
+}
+
+/*
+ * Record the fault raised by the last entry and dump the ring
+ */
+void trace_fault(uint32_t status)
+{
+    ring.status = status;
+    trace_dump();
+}
+
+/*
+ * Dump on a crash, then die of the same signal. SIGUSR1 dumps and carries on.
+ */
+static void handle_signal(int signal_number)
+{
+    trace_dump();
+
+    if (signal_number != SIGUSR1)
+    {
+        signal(signal_number, SIG_DFL);
+        raise(signal_number);
+    }
+}
+
+/*
+ * Start recording every instruction this thread executes into a ring of
+ * num_entries, a power of two. The ring is written to filename on a fault,
+ * a crash or SIGUSR1.
+ */
+bool trace_init(const char *filename, uint32_t num_entries)
+{
+    if (num_entries == 0 || (num_entries & (num_entries - 1)) != 0)
+    {
+        printf("Trace size must be a power of two\n");
+        return false;
+    }
+
+    if (strlen(filename) >= sizeof(dump_filename))
+    {
+        printf("Trace filename is too long\n");
+        return false;
+    }
+
+    ring.entries = calloc(num_entries, sizeof(TraceEntry));
+    if (ring.entries == NULL)
+    {
+        perror("Failed to allocate trace buffer");
+        return false;
+    }
+
+    ring.mask = num_entries - 1;
+    ring.total = 0;
+    ring.status = 0;
+    strcpy(dump_filename, filename);
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = handle_signal;
+    sigemptyset(&action.sa_mask);
+
+    action.sa_flags = SA_RESTART;
+    sigaction(SIGUSR1, &action, NULL);
+
+    action.sa_flags = 0;
+    for (size_t i = 0; i < sizeof(CRASH_SIGNALS) / sizeof(CRASH_SIGNALS[0]); i++)
+    {
+        sigaction(CRASH_SIGNALS[i], &action, NULL);
+    }
+
+    trace_ring = &ring;
+    return true;
+}
+
+#else
+
+bool trace_init(const char *filename, uint32_t num_entries)
+{
+    (void)filename;
+    (void)num_entries;
+    printf("Tracing is not available; configure with -DCHIP8_TRACE=ON\n");
+    return false;
+}
+
+void trace_fault(uint32_t status)
+{
+    (void)status;
+}
+
+void trace_dump(void)
+{
+}
+
+#endif // CHIP8_TRACE
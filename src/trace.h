@@ -0,0 +1,139 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define TRACE_MAGIC "C8TRACE"
+#define TRACE_VERSION 1
+
+// Instructions kept by default, about an hour at 600 Hz; a power of two, 8 bytes each
+#define TRACE_DEFAULT_ENTRIES (1u << 21)
+
+typedef struct TraceEntry_t TraceEntry;
+typedef struct TraceHeader_t TraceHeader;
+typedef struct TraceRing_t TraceRing;
+typedef struct TraceCursor_t TraceCursor;
+
+/*
+ * One executed instruction and the state it left behind. Only Vx of the
+ * opcode, VF and I are kept; the decoder knows which of them each
+ * instruction writes.
+ */
+struct TraceEntry_t
+{
+    uint16_t pc;
+    uint16_t opcode;
+    uint16_t I;
+    uint16_t registers; // Vx in the low byte, VF in the high byte
+};
+
+_Static_assert(sizeof(TraceEntry) == 8, "Trace entries must stay 8 bytes");
+
+/*
+ * Start of a trace file. The entries follow, oldest first, and the entry
+ * numbered total - 1 is the last one recorded. When tracing starts at
+ * power-on, entry numbers are cycle counts.
+ */
+struct TraceHeader_t
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t num_entries; // Entries in the file
+    uint64_t total;       // Instructions recorded since tracing started
+    uint32_t status;      // Fault raised by the last entry, or CHIP8_OK
+    uint32_t reserved;
+};
+
+struct TraceRing_t
+{
+    TraceEntry *entries;
+    uint64_t total;
+    uint32_t mask;
+    uint32_t status;
+};
+
+/*
+ * Copy of a ring's position that a run loop keeps in registers. The total is
+ * only stored back to the ring when the loop saves it, before anything that
+ * may dump and when the run ends, so a dump from a signal handler in the
+ * middle of a run misses the entries that run has recorded so far.
+ */
+struct TraceCursor_t
+{
+    TraceRing *ring;
+    TraceEntry *entries;
+    uint64_t total;
+    uint32_t mask;
+};
+
+#ifdef CHIP8_TRACE
+
+// Ring of the thread that called trace_init, NULL on every other thread
+extern _Thread_local TraceRing *trace_ring;
+
+static inline TraceCursor trace_cursor(void)
+{
+    TraceRing *ring = trace_ring;
+    if (ring == NULL)
+        return (TraceCursor){NULL, NULL, 0, 0};
+
+    return (TraceCursor){ring, ring->entries, ring->total, ring->mask};
+}
+
+static inline void trace_cursor_record(TraceCursor *cursor, uint16_t pc, uint16_t opcode, uint16_t I,
+                                       uint8_t vx, uint8_t vf)
+{
+    cursor->entries[cursor->total & cursor->mask] = (TraceEntry){pc, opcode, I, vx | (vf << 8)};
+    cursor->total++;
+}
+
+static inline void trace_record(uint16_t pc, uint16_t opcode, uint16_t I, uint8_t vx, uint8_t vf)
+{
+    TraceRing *ring = trace_ring;
+    if (ring == NULL)
+        return;
+
+    ring->entries[ring->total & ring->mask] = (TraceEntry){pc, opcode, I, vx | (vf << 8)};
+    ring->total++;
+}
+
+// For state that is only worth keeping when it will be recorded
+#define TRACE_ENABLED 1
+
+// Whether this thread is recording, for run loops to check once per call
+#define TRACE_ACTIVE() (trace_ring != NULL)
+
+// Record one instruction
+#define TRACE_RECORD(...) trace_record(__VA_ARGS__)
+
+// Record the instructions of a run loop through a cursor held in a local.
+// RECORD, SAVE and LOAD are only for while TRACE_ACTIVE(); SAVE stores the
+// cursor's total back to the ring, and LOAD picks up entries recorded
+// through the ring meanwhile.
+#define TRACE_RUN_BEGIN() TraceCursor trace_run_cursor = trace_cursor()
+#define TRACE_RUN_RECORD(...) trace_cursor_record(&trace_run_cursor, __VA_ARGS__)
+#define TRACE_RUN_SAVE() (trace_run_cursor.ring->total = trace_run_cursor.total)
+#define TRACE_RUN_LOAD() (trace_run_cursor.total = trace_run_cursor.ring->total)
+
+#define TRACE_FAULT(status) trace_fault(status)
+
+#else
+
+#define TRACE_ENABLED 0
+#define TRACE_ACTIVE() false
+#define TRACE_RECORD(...) ((void)0)
+#define TRACE_RUN_BEGIN() ((void)0)
+#define TRACE_RUN_RECORD(...) ((void)0)
+#define TRACE_RUN_SAVE() ((void)0)
+#define TRACE_RUN_LOAD() ((void)0)
+#define TRACE_FAULT(status) ((void)0)
+
+#endif // CHIP8_TRACE
+
+bool trace_init(const char *filename, uint32_t num_entries);
+void trace_fault(uint32_t status);
+void trace_dump(void);
+
+#endif // TRACE_H
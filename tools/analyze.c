@@ -0,0 +1,109 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "analysis.h"
+#include "disassembler.h"
+
+typedef enum RegionKind_t
+{
+    REGION_CODE,
+    REGION_DATA,
+    REGION_UNREACHABLE,
+} RegionKind;
+
+static const char *const REGION_NAMES[] = {"code", "data", "unreachable"};
+
+/*
+ * Classify a ROM byte. Bytes that are not code belong to data if they follow
+ * an address loaded into I, without code in between.
+ */
+static RegionKind classify(const Analysis *analysis, uint16_t address, RegionKind previous)
+{
+    uint8_t flags = analysis->flags[address];
+
+    if (flags & (ANALYSIS_CODE | ANALYSIS_OPERAND))
+        return REGION_CODE;
+    if (flags & ANALYSIS_DATA || previous == REGION_DATA)
+        return REGION_DATA;
+    return REGION_UNREACHABLE;
+}
+
+static void print_regions(const Analysis *analysis)
+{
+    uint16_t start = START_ADDRESS;
+    RegionKind kind = classify(analysis, START_ADDRESS, REGION_UNREACHABLE);
+
+    printf("Regions:\n");
+    for (uint16_t address = START_ADDRESS + 1; address <= analysis->rom_end; address++)
+    {
+        RegionKind next = address < analysis->rom_end ? classify(analysis, address, kind) : kind;
+        if (address < analysis->rom_end && next == kind)
+            continue;
+
+        printf("  0x%03X-0x%03X  %-11s (%d bytes)\n", start, address - 1, REGION_NAMES[kind],
+               address - start);
+        start = address;
+        kind = next;
+    }
+}
+
+/*
+ * List every instruction carrying one of the given flags
+ */
+static void print_flagged(const Analysis *analysis, const uint8_t *memory, uint8_t flag,
+                          const char *title)
+{
+    char text[DISASM_MAX_LENGTH];
+    bool printed_title = false;
+
+    for (unsigned int address = 0; address < TOTAL_RAM; address++)
+    {
+        if (!(analysis->flags[address] & flag))
+            continue;
+
+        if (!printed_title)
+        {
+            printf("%s:\n", title);
+            printed_title = true;
+        }
+
+        uint16_t opcode = (memory[address] << 8) | memory[(address + 1) & RAM_MASK];
+        chip8_disassemble(opcode, text, sizeof(text));
+        printf("  0x%03X: %04X  %s\n", address, opcode, text);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 2)
+    {
+        printf("Usage: %s <rom>\n", argv[0]);
+        return 1;
+    }
+
+    // The same image the emulator maps, so code that reads the fontset is seen as it runs
+    static Chip8Image image;
+    chip8_image_init(&image);
+    if (!chip8_image_load_rom(&image, argv[1]))
+        return 1;
+    const uint8_t *memory = image.memory;
+
+    static Analysis analysis;
+    chip8_analyze(&analysis, memory, image.rom_size);
+
+    printf("%s: %d bytes, %d reachable instructions\n", argv[1], image.rom_size,
+           analysis.num_instructions);
+
+    print_regions(&analysis);
+    print_flagged(&analysis, memory, ANALYSIS_CALL_TARGET, "Subroutines");
+    print_flagged(&analysis, memory, ANALYSIS_IDLE_LOOP, "Idle loops");
+    print_flagged(&analysis, memory, ANALYSIS_SELF_MODIFY, "Stores into code");
+    print_flagged(&analysis, memory, ANALYSIS_INDIRECT_JUMP, "Indirect jumps");
+
+    if (analysis.num_unknown_stores > 0)
+        printf("%d stores with an unknown I\n", analysis.num_unknown_stores);
+    if (analysis.num_illegal > 0)
+        printf("%d reachable addresses do not decode\n", analysis.num_illegal);
+
+    return 0;
+}
@@ -0,0 +1,369 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "analysis.h"
+#include "disassembler.h"
+
+/*
+ * Translate a ROM into C. Every reachable instruction becomes a labelled block
+ * that runs it with its operands as constants and jumps straight to its
+ * successor. Register and control flow instructions are written out inline;
+ * the rest call their op_ handlers. Anything the analysis could not follow,
+ * such as JP V0 targets or return addresses, goes through a switch on PC, and
+ * addresses outside the translation, or that fault, go to the interpreter.
+ */
+
+static Analysis analysis;
+static uint8_t image[TOTAL_RAM];
+
+static bool is_translated(uint16_t address)
+{
+    return analysis.flags[address & RAM_MASK] & ANALYSIS_CODE;
+}
+
+/*
+ * Continue at target: count the cycle, then jump to its block, or dispatch
+ * on PC if there is none
+ */
+static void emit_goto(FILE *out, unsigned int target)
+{
+    fprintf(out, "    TICK(0x%03X);\n", target);
+    if (target <= RAM_MASK && is_translated(target))
+        fprintf(out, "    goto a_%03X;\n", target);
+    else
+        fprintf(out, "    chip8->PC = 0x%03X;\n    goto dispatch;\n", target);
+}
+
+static void emit_skip(FILE *out, const char *condition, unsigned int next, unsigned int skip)
+{
+    fprintf(out, "    if (%s)\n    {\n", condition);
+    emit_goto(out, skip);
+    fprintf(out, "    }\n");
+    emit_goto(out, next);
+}
+
+/*
+ * Run an instruction through its handler, the way the interpreter does
+ */
+static void emit_handler(FILE *out, const char *handler, uint16_t address, uint16_t opcode)
+{
+    fprintf(out, "    SET(0x%03X, 0x%04X);\n    %s(chip8);\n", address, opcode, handler);
+}
+
+/*
+ * FX33 and FX55 may overwrite translated code. If they do, the rest of the
+ * run goes to the interpreter.
+ */
+static void emit_store(FILE *out, const char *handler, uint16_t address, uint16_t opcode,
+                       unsigned int length, unsigned int next)
+{
+    fprintf(out, "    start = chip8->I;\n");
+    emit_handler(out, handler, address, opcode);
+    fprintf(out, "    if (chip8->out_of_memory)\n    {\n");
+    fprintf(out, "        chip8->PC = 0x%03X;\n        goto interpret;\n    }\n", address);
+    fprintf(out, "    if (aot_code_changed(chip8, CODE_MAP, start, %u))\n    {\n", length);
+    fprintf(out, "        code_valid = false;\n");
+    fprintf(out, "        TICK(0x%03X);\n        chip8->PC = 0x%03X;\n", next, next);
+    fprintf(out, "        return run_interpreter(chip8);\n    }\n");
+    emit_goto(out, next);
+}
+
+static void emit_instruction(FILE *out, uint16_t address)
+{
+    uint16_t opcode = (image[address] << 8) | image[(address + 1) & RAM_MASK];
+    unsigned int x = (opcode & 0x0F00) >> 8;
+    unsigned int y = (opcode & 0x00F0) >> 4;
+    unsigned int kk = opcode & 0x00FF;
+    unsigned int nnn = opcode & 0x0FFF;
+
+    // The interpreter does not wrap PC until it fetches, so neither do these
+    unsigned int next = address + 2;
+    unsigned int skip = address + 4;
+
+    char condition[64];
+    char text[DISASM_MAX_LENGTH];
+    chip8_disassemble(opcode, text, sizeof(text));
+    fprintf(out, "a_%03X: // %s\n", address, text);
+
+    switch (opcode & 0xF000)
+    {
+    case 0x0000:
+        if (opcode == 0x00E0)
+        {
+            emit_handler(out, "op_0x00E0", address, opcode);
+            emit_goto(out, next);
+        }
+        else
+        {
+            // A return address is only known at run time
+            fprintf(out, "    if (chip8->SP == 0)\n    {\n");
+            fprintf(out, "        chip8->PC = 0x%03X;\n        goto interpret;\n    }\n", address);
+            fprintf(out, "    chip8->SP--;\n    chip8->PC = chip8->stack[chip8->SP & STACK_MASK];\n");
+            fprintf(out, "    if (aot_tick(chip8))\n        return CHIP8_FRAME;\n    goto dispatch;\n");
+        }
+        break;
+
+    case 0x1000:
+        emit_goto(out, nnn);
+        break;
+
+    case 0x2000:
+        fprintf(out, "    if (chip8->SP >= STACK_SIZE)\n    {\n");
+        fprintf(out, "        chip8->PC = 0x%03X;\n        goto interpret;\n    }\n", address);
+        fprintf(out, "    chip8->stack[chip8->SP & STACK_MASK] = 0x%03X;\n    chip8->SP++;\n", next);
+        emit_goto(out, nnn);
+        break;
+
+    case 0x3000:
+    case 0x4000:
+        snprintf(condition, sizeof(condition), "chip8->V[%u] %s 0x%02X", x,
+                 (opcode & 0xF000) == 0x3000 ? "==" : "!=", kk);
+        emit_skip(out, condition, next, skip);
+        break;
+
+    case 0x5000:
+    case 0x9000:
+        snprintf(condition, sizeof(condition), "chip8->V[%u] %s chip8->V[%u]", x,
+                 (opcode & 0xF000) == 0x5000 ? "==" : "!=", y);
+        emit_skip(out, condition, next, skip);
+        break;
+
+    case 0x6000:
+        fprintf(out, "    chip8->V[%u] = 0x%02X;\n", x, kk);
+        emit_goto(out, next);
+        break;
+
+    case 0x7000:
+        fprintf(out, "    chip8->V[%u] += 0x%02X;\n", x, kk);
+        emit_goto(out, next);
+        break;
+
+    case 0x8000:
+        // Flags are written before Vx, as the handlers do
+        switch (opcode & 0x000F)
+        {
+        case 0x0:
+            fprintf(out, "    chip8->V[%u] = chip8->V[%u];\n", x, y);
+            break;
+        case 0x1:
+            fprintf(out, "    chip8->V[%u] |= chip8->V[%u];\n", x, y);
+            break;
+        case 0x2:
+            fprintf(out, "    chip8->V[%u] &= chip8->V[%u];\n", x, y);
+            break;
+        case 0x3:
+            fprintf(out, "    chip8->V[%u] ^= chip8->V[%u];\n", x, y);
+            break;
+        case 0x4:
+            fprintf(out, "    sum = chip8->V[%u] + chip8->V[%u];\n", x, y);
+            fprintf(out, "    chip8->V[15] = sum > 255;\n    chip8->V[%u] = sum & 0xFF;\n", x);
+            break;
+        case 0x5:
+            fprintf(out, "    chip8->V[15] = chip8->V[%u] > chip8->V[%u];\n", x, y);
+            fprintf(out, "    chip8->V[%u] -= chip8->V[%u];\n", x, y);
+            break;
+        case 0x6:
+            fprintf(out, "    chip8->V[15] = chip8->V[%u] & 1;\n    chip8->V[%u] >>= 1;\n", x, x);
+            break;
+        case 0x7:
+            fprintf(out, "    chip8->V[15] = chip8->V[%u] > chip8->V[%u];\n", y, x);
+            fprintf(out, "    chip8->V[%u] = chip8->V[%u] - chip8->V[%u];\n", x, y, x);
+            break;
+        case 0xE:
+            fprintf(out, "    chip8->V[15] = chip8->V[%u] >> 7;\n    chip8->V[%u] <<= 1;\n", x, x);
+            break;
+        }
+        emit_goto(out, next);
+        break;
+
+    case 0xA000:
+        fprintf(out, "    chip8->I = 0x%03X;\n", nnn);
+        emit_goto(out, next);
+        break;
+
+    case 0xB000:
+        fprintf(out, "    chip8->PC = 0x%03X + chip8->V[0];\n", nnn);
+        fprintf(out, "    if (aot_tick(chip8))\n        return CHIP8_FRAME;\n    goto dispatch;\n");
+        break;
+
+    case 0xC000:
+        emit_handler(out, "op_0xCXKK", address, opcode);
+        emit_goto(out, next);
+        break;
+
+    case 0xD000:
+        emit_handler(out, "op_0xDXYN", address, opcode);
+        emit_goto(out, next);
+        break;
+
+    case 0xE000:
+        snprintf(condition, sizeof(condition), "%schip8->keypad[chip8->V[%u] & 0xF]",
+                 kk == 0x9E ? "" : "!", x);
+        emit_skip(out, condition, next, skip);
+        break;
+
+    case 0xF000:
+        switch (kk)
+        {
+        case 0x07:
+            fprintf(out, "    chip8->V[%u] = chip8->delay_timer;\n", x);
+            break;
+        case 0x0A:
+            // Without a key the handler rewinds PC and the instruction repeats
+            emit_handler(out, "op_0xFX0A", address, opcode);
+            fprintf(out, "    if (chip8->PC == 0x%03X)\n    {\n", address);
+            emit_goto(out, address);
+            fprintf(out, "    }\n");
+            break;
+        case 0x15:
+            fprintf(out, "    chip8->delay_timer = chip8->V[%u];\n", x);
+            break;
+        case 0x18:
+            fprintf(out, "    chip8->sound_timer = chip8->V[%u];\n", x);
+            break;
+        case 0x1E:
+            fprintf(out, "    chip8->I += chip8->V[%u];\n", x);
+            break;
+        case 0x29:
+            emit_handler(out, "op_0xFX29", address, opcode);
+            break;
+        case 0x33:
+            emit_store(out, "op_0xFX33", address, opcode, 3, next);
+            return;
+        case 0x55:
+            emit_store(out, "op_0xFX55", address, opcode, x + 1, next);
+            return;
+        case 0x65:
+            emit_handler(out, "op_0xFX65", address, opcode);
+            break;
+        }
+        emit_goto(out, next);
+        break;
+    }
+}
+
+static void emit_program(FILE *out, const char *rom_filename, long rom_size)
+{
+    fprintf(out, "/* Generated by chip8-aot from %s. Do not edit. */\n\n", rom_filename);
+    fprintf(out, "#include \"aot.h\"\n\n");
+    fprintf(out, "#define SET(address, opcode) \\\n"
+                 "    chip8->PC = (address) + 2; \\\n"
+                 "    chip8->current_op = (opcode)\n\n");
+    fprintf(out, "#define TICK(next)              \\\n"
+                 "    if (aot_tick(chip8))        \\\n"
+                 "    {                           \\\n"
+                 "        chip8->PC = (next);     \\\n"
+                 "        return CHIP8_FRAME;     \\\n"
+                 "    }\n\n");
+
+    fprintf(out, "const uint16_t aot_rom_size = %ld;\n\n", rom_size);
+    fprintf(out, "const uint8_t aot_image[TOTAL_RAM] = {");
+    for (int address = 0; address < TOTAL_RAM; address++)
+    {
+        fprintf(out, "%s0x%02X,", address % 16 == 0 ? "\n    " : " ", image[address]);
+    }
+    fprintf(out, "\n};\n\n");
+
+    fprintf(out, "// A bit per byte of every translated instruction\n");
+    fprintf(out, "static const uint8_t CODE_MAP[TOTAL_RAM / 8] = {");
+    for (int byte = 0; byte < TOTAL_RAM / 8; byte++)
+    {
+        uint8_t bits = 0;
+        for (int bit = 0; bit < 8; bit++)
+        {
+            if (analysis.flags[byte * 8 + bit] & (ANALYSIS_CODE | ANALYSIS_OPERAND))
+                bits |= 1 << bit;
+        }
+        fprintf(out, "%s0x%02X,", byte % 16 == 0 ? "\n    " : " ", bits);
+    }
+    fprintf(out, "\n};\n\n");
+
+    fprintf(out, "// Cleared for good once the program overwrites its own code\n");
+    fprintf(out, "static bool code_valid = true;\n\n");
+    fprintf(out, "static Chip8Status run_interpreter(Chip8 *chip8)\n{\n");
+    fprintf(out, "    return chip8_run(chip8, chip8->next_frame - chip8->cycles, CHIP8_STOP_ON(CHIP8_FRAME));\n}\n\n");
+
+    fprintf(out, "Chip8Status aot_run_frame(Chip8 *chip8)\n{\n");
+    fprintf(out, "    Chip8Status status;\n    uint16_t sum;\n    uint16_t start;\n");
+    fprintf(out, "    (void)sum;\n    (void)start;\n    (void)CODE_MAP;\n\n");
+    fprintf(out, "    if (!code_valid)\n        return run_interpreter(chip8);\n\n");
+
+    fprintf(out, "dispatch:\n    switch (chip8->PC)\n    {\n");
+    for (int address = 0; address < TOTAL_RAM; address++)
+    {
+        if (is_translated(address))
+            fprintf(out, "    case 0x%03X:\n        goto a_%03X;\n", address, address);
+    }
+    fprintf(out, "    default:\n        goto interpret;\n    }\n\n");
+
+    // One instruction at a time, so execution returns to translated code when it
+    // can. Stores run here are checked like translated ones.
+    fprintf(out, "interpret:\n");
+    fprintf(out, "    start = chip8->I;\n");
+    fprintf(out, "    status = chip8_run(chip8, 1, CHIP8_STOP_ALL);\n");
+    fprintf(out, "    if (aot_store_changed_code(chip8, CODE_MAP, start))\n        code_valid = false;\n");
+    fprintf(out, "    if (status == CHIP8_FRAME || CHIP8_IS_FAULT(status))\n        return status;\n");
+    fprintf(out, "    if (!code_valid)\n        return run_interpreter(chip8);\n");
+    fprintf(out, "    goto dispatch;\n\n");
+
+    for (int address = 0; address < TOTAL_RAM; address++)
+    {
+        if (is_translated(address))
+            emit_instruction(out, address);
+    }
+
+    fprintf(out, "}\n");
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 3)
+    {
+        printf("Usage: %s <rom> <output.c>\n", argv[0]);
+        return 1;
+    }
+
+    // Translate exactly what a machine holds at power-on
+    Chip8 *chip8 = aligned_alloc(_Alignof(Chip8), sizeof(Chip8));
+    if (chip8 == NULL)
+    {
+        perror("Failed to allocate emulator");
+        return 1;
+    }
+
+    chip8_init(chip8);
+    if (!chip8_load_rom(chip8, argv[1]))
+        return 1;
+
+    long rom_size = TOTAL_RAM - START_ADDRESS;
+    while (rom_size > 0 && chip8_read(chip8, START_ADDRESS + rom_size - 1) == 0)
+        rom_size--;
+
+    for (int address = 0; address < TOTAL_RAM; address++)
+    {
+        image[address] = chip8_read(chip8, address);
+    }
+    chip8_release(chip8);
+    free(chip8);
+
+    chip8_analyze(&analysis, image, rom_size);
+
+    FILE *out = fopen(argv[2], "w");
+    if (out == NULL)
+    {
+        perror("Failed to open output");
+        return 1;
+    }
+
+    emit_program(out, argv[1], rom_size);
+    fclose(out);
+
+    printf("%s: translated %d instructions", argv[1], analysis.num_instructions);
+    if (analysis.num_indirect_jumps > 0)
+        printf(", %d indirect jumps dispatched at run time", analysis.num_indirect_jumps);
+    if (analysis.num_self_modifying > 0)
+        printf(", %d stores into code", analysis.num_self_modifying);
+    printf("\n");
+
+    return 0;
+}
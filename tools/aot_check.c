@@ -0,0 +1,87 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "aot.h"
+
+/*
+ * Differential check of a ROM translated by chip8-aot. Linked with the
+ * generated C, it runs the translation and chip8_run side by side with the
+ * same keys and fails on the first frame where the machines differ.
+ */
+
+#define DEFAULT_FRAMES 5000
+
+// Frames each random key mask is held for
+#define KEY_FRAMES 20
+
+static bool same_memory(const Chip8 *a, const Chip8 *b)
+{
+    for (int page = 0; page < NUM_RAM_PAGES; page++)
+    {
+        if (memcmp(a->pages[page], b->pages[page], RAM_PAGE_SIZE) != 0)
+            return false;
+    }
+
+    return true;
+}
+
+/*
+ * Compare the state both engines keep exactly. current_op is left out, since
+ * translated code only sets it for the instructions that go through a handler.
+ */
+static bool same_state(const Chip8 *a, const Chip8 *b)
+{
+    return a->PC == b->PC && a->I == b->I && a->SP == b->SP && a->cycles == b->cycles &&
+           a->next_frame == b->next_frame && a->rng_state == b->rng_state &&
+           a->delay_timer == b->delay_timer && a->sound_timer == b->sound_timer &&
+           memcmp(a->V, b->V, sizeof(a->V)) == 0 &&
+           memcmp(a->stack, b->stack, sizeof(a->stack)) == 0 &&
+           memcmp(a->screen, b->screen, sizeof(a->screen)) == 0 && same_memory(a, b);
+}
+
+int main(int argc, char *argv[])
+{
+    int frames = argc > 1 ? atoi(argv[1]) : DEFAULT_FRAMES;
+
+    static Chip8 translated;
+    static Chip8 interpreted;
+    Chip8 *machines[] = {&translated, &interpreted};
+    for (int m = 0; m < 2; m++)
+    {
+        chip8_init(machines[m]);
+        chip8_seed(machines[m], 1);
+        chip8_write_block(machines[m], START_ADDRESS, &aot_image[START_ADDRESS], aot_rom_size);
+    }
+
+    srand(1);
+    for (int frame = 0; frame < frames; frame++)
+    {
+        if (frame % KEY_FRAMES == 0)
+        {
+            // Sparse masks, so games see single keys as well as chords
+            uint16_t keys = rand() & rand();
+            for (int k = 0; k < NUM_KEYS; k++)
+            {
+                translated.keypad[k] = interpreted.keypad[k] = (keys >> k) & 1;
+            }
+        }
+
+        Chip8Status expected =
+            chip8_run(&interpreted, interpreted.cycles_per_frame, CHIP8_STOP_ON(CHIP8_FRAME));
+        Chip8Status status = aot_run_frame(&translated);
+        if (status != expected || !same_state(&translated, &interpreted))
+        {
+            printf("Diverged in frame %d: %s at PC 0x%03X, interpreter %s at PC 0x%03X\n", frame,
+                   chip8_status_string(status), translated.PC, chip8_status_string(expected),
+                   interpreted.PC);
+            return 1;
+        }
+
+        if (CHIP8_IS_FAULT(status))
+            break;
+    }
+
+    printf("Translation matches the interpreter\n");
+    return 0;
+}
@@ -0,0 +1,147 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "chip8.h"
+#include "disassembler.h"
+
+#define DEFAULT_INSTANCES 64
+#define DEFAULT_CYCLES 20000000ULL
+
+// Instructions each instance runs before the next one takes over
+#define SLICE_CYCLES 1000
+
+// Where the stores and loads point, away from the program
+#define DATA_ADDRESS 0x800
+
+typedef struct Benchmark_t Benchmark;
+
+struct Benchmark_t
+{
+    uint16_t opcode;
+    uint8_t x_value; // Value in Vx, for the BCD conversion
+};
+
+/*
+ * The instructions under test. LD V0, byte measures the cost of dispatch alone.
+ */
+static const Benchmark BENCHMARKS[] = {
+    {0x6000, 0},
+    {0xF533, 7},
+    {0xF533, 255},
+    {0xF355, 0},
+    {0xFF55, 0},
+    {0xF365, 0},
+    {0xFF65, 0},
+};
+
+static double now(void)
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+/*
+ * Fill the program area with one instruction followed by a jump back, so
+ * nearly every cycle runs the instruction under test
+ */
+static void build_image(Chip8Image *image, uint16_t opcode)
+{
+    chip8_image_init(image);
+
+    uint16_t address = START_ADDRESS;
+    for (; address < START_ADDRESS + 0x100 - 2; address += 2)
+    {
+        image->memory[address] = opcode >> 8;
+        image->memory[address + 1] = opcode & 0xFF;
+    }
+    image->memory[address] = 0x10 | (START_ADDRESS >> 8);
+    image->memory[address + 1] = START_ADDRESS & 0xFF;
+    image->rom_size = 0x100;
+}
+
+/*
+ * Run one instruction across every instance and return nanoseconds per instruction
+ */
+static double run_benchmark(const Benchmark *benchmark, Chip8 *machines, int num_instances,
+                            unsigned long long cycles)
+{
+    static Chip8Image image;
+    build_image(&image, benchmark->opcode);
+
+    for (int m = 0; m < num_instances; m++)
+    {
+        chip8_init(&machines[m]);
+        chip8_attach_image(&machines[m], &image);
+        machines[m].I = DATA_ADDRESS;
+        memset(machines[m].V, benchmark->x_value, sizeof(machines[m].V));
+
+        // Warm up, so copying pages on the first write is not timed
+        chip8_run(&machines[m], SLICE_CYCLES, 0);
+    }
+
+    unsigned long long rounds = cycles / ((unsigned long long)num_instances * SLICE_CYCLES);
+    if (rounds == 0)
+        rounds = 1;
+
+    double start = now();
+    for (unsigned long long r = 0; r < rounds; r++)
+    {
+        for (int m = 0; m < num_instances; m++)
+        {
+            Chip8Status status = chip8_run(&machines[m], SLICE_CYCLES, 0);
+            if (CHIP8_IS_FAULT(status))
+            {
+                printf("Benchmark stopped: %s\n", chip8_status_string(status));
+                exit(EXIT_FAILURE);
+            }
+        }
+    }
+    double elapsed = now() - start;
+
+    for (int m = 0; m < num_instances; m++)
+    {
+        chip8_release(&machines[m]);
+    }
+
+    return elapsed * 1e9 / (rounds * num_instances * SLICE_CYCLES);
+}
+
+int main(int argc, char *argv[])
+{
+    int num_instances = argc > 1 ? atoi(argv[1]) : DEFAULT_INSTANCES;
+    unsigned long long cycles = argc > 2 ? strtoull(argv[2], NULL, 10) : DEFAULT_CYCLES;
+    if (argc > 3 || num_instances <= 0 || cycles == 0)
+    {
+        printf("Usage: %s [instances] [cycles]\n", argv[0]);
+        return 1;
+    }
+
+    Chip8 *machines = aligned_alloc(_Alignof(Chip8), sizeof(Chip8) * num_instances);
+    if (machines == NULL)
+    {
+        perror("Failed to allocate instances");
+        return 1;
+    }
+
+    printf("%d instances, %llu cycles per benchmark\n", num_instances, cycles);
+    printf("%-16s %4s %10s %12s\n", "instruction", "Vx", "ns/instr", "over LD Vx");
+
+    double baseline = 0;
+    for (size_t b = 0; b < sizeof(BENCHMARKS) / sizeof(BENCHMARKS[0]); b++)
+    {
+        char text[DISASM_MAX_LENGTH];
+        chip8_disassemble(BENCHMARKS[b].opcode, text, sizeof(text));
+
+        double ns = run_benchmark(&BENCHMARKS[b], machines, num_instances, cycles);
+        if (b == 0)
+            baseline = ns;
+
+        printf("%-16s %4u %10.2f %12.2f\n", text, BENCHMARKS[b].x_value, ns, ns - baseline);
+    }
+
+    free(machines);
+    return 0;
+}
@@ -0,0 +1,332 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "chip8.h"
+#include "lockstep.h"
+
+// Upper bound on instructions executed per input, enough for hundreds of frames
+#define MAX_CYCLES 6000
+
+// Longest run between comparisons. Runs take every length from 1 to this in
+// turn; it is not a multiple of the default CYCLES_PER_FRAME, so runs start
+// and end at every point within a frame.
+#define STEP_CYCLES 37
+
+// Machines in the lockstep group, each with its own reference
+#define GROUP_LANES 8
+
+// Bytes of initial machine state at the start of every input
+#define STATE_HEADER_SIZE (NUM_REGISTERS + 2 + 3 + 2)
+
+/*
+ * Runs up to cycles instructions, stopping early only on a fault. Returns the
+ * fault, or CHIP8_OK if every cycle ran.
+ */
+typedef Chip8Status (*Engine)(Chip8 *chip8, unsigned int cycles);
+
+/*
+ * The reference: one instruction at a time through chip8_cycle
+ */
+static Chip8Status run_cycles(Chip8 *chip8, unsigned int cycles)
+{
+    for (unsigned int c = 0; c < cycles; c++)
+    {
+        Chip8Status status = chip8_cycle(chip8);
+        if (CHIP8_IS_FAULT(status))
+            return status;
+    }
+
+    return CHIP8_OK;
+}
+
+/*
+ * Single step through the register-hoisted fast path, so every instruction
+ * enters and leaves it
+ */
+static Chip8Status run_single(Chip8 *chip8, unsigned int cycles)
+{
+    for (unsigned int c = 0; c < cycles; c++)
+    {
+        Chip8Status status = chip8_run(chip8, 1, CHIP8_STOP_ALL);
+        if (CHIP8_IS_FAULT(status))
+            return status;
+    }
+
+    return CHIP8_OK;
+}
+
+/*
+ * The whole batch in one call, with PC, I and V kept in locals throughout
+ * and only written back when the run ends
+ */
+static Chip8Status run_batch(Chip8 *chip8, unsigned int cycles)
+{
+    return chip8_run(chip8, cycles, 0);
+}
+
+/*
+ * A lockstep group of one lane, which never diverges, so every
+ * register-only instruction takes the vector path
+ */
+static Chip8Status run_lockstep(Chip8 *chip8, unsigned int cycles)
+{
+    Lockstep lockstep;
+    lockstep_init(&lockstep);
+    lockstep_add(&lockstep, chip8);
+    return lockstep_run(&lockstep, cycles);
+}
+
+/*
+ * Every execution engine to compare. The first entry is the reference that the
+ * others are checked against after each run.
+ *
+ * Engines are compared where a run returns, because that is the only place
+ * their state is defined: in between, chip8_run keeps registers in locals and
+ * lockstep in lane columns. Run lengths cycle through every value from 1 to
+ * STEP_CYCLES, so the comparisons move around within loops and frames, and a
+ * wrong value that a later instruction overwrites is caught by whichever run
+ * ends between the two. All engines share the op_
+ * handlers with the reference. This checks the fast paths and the vector path
+ * against the handlers, while the handlers themselves are checked by the
+ * golden frames.
+ */
+static const Engine ENGINES[] = {
+    run_cycles,
+    run_single,
+    run_batch,
+    run_lockstep,
+};
+
+#define NUM_ENGINES (sizeof(ENGINES) / sizeof(ENGINES[0]))
+
+/*
+ * Length of the run numbered run, cycling through 1 to STEP_CYCLES
+ */
+static unsigned int run_length(int run)
+{
+    return 1 + (run * 7) % STEP_CYCLES;
+}
+
+/*
+ * Build a machine from fuzz input: registers, timers and keypad first,
+ * then the program loaded at START_ADDRESS
+ */
+static void load_input(Chip8 *chip8, const uint8_t *data, size_t size)
+{
+    chip8_init(chip8);
+
+    memcpy(chip8->V, data, NUM_REGISTERS);
+    data += NUM_REGISTERS;
+
+    chip8->I = (data[0] << 8) | data[1];
+    chip8->SP = data[2] % (STACK_SIZE + 1);
+    chip8->delay_timer = data[3];
+    chip8->sound_timer = data[4];
+
+    uint16_t keys = (data[5] << 8) | data[6];
+    for (int i = 0; i < NUM_KEYS; i++)
+    {
+        chip8->keypad[i] = (keys >> i) & 1;
+    }
+
+    data += 7;
+    size -= STATE_HEADER_SIZE;
+
+    if (size > TOTAL_RAM - START_ADDRESS)
+        size = TOTAL_RAM - START_ADDRESS;
+    chip8_write_block(chip8, START_ADDRESS, data, size);
+}
+
+static bool same_memory(const Chip8 *a, const Chip8 *b)
+{
+    for (int page = 0; page < NUM_RAM_PAGES; page++)
+    {
+        if (memcmp(a->pages[page], b->pages[page], RAM_PAGE_SIZE) != 0)
+            return false;
+    }
+
+    return true;
+}
+
+/*
+ * Compare the architecturally visible state of two machines
+ */
+static bool same_state(const Chip8 *a, const Chip8 *b)
+{
+    return a->PC == b->PC && a->I == b->I && a->SP == b->SP &&
+           a->current_op == b->current_op && a->fault_pc == b->fault_pc &&
+           a->cycles == b->cycles && a->next_frame == b->next_frame &&
+           a->rng_state == b->rng_state &&
+           a->delay_timer == b->delay_timer && a->sound_timer == b->sound_timer &&
+           memcmp(a->V, b->V, sizeof(a->V)) == 0 &&
+           memcmp(a->stack, b->stack, sizeof(a->stack)) == 0 &&
+           memcmp(a->screen, b->screen, sizeof(a->screen)) == 0 &&
+           same_memory(a, b);
+}
+
+/*
+ * FNV-1a hash of the input, the source of the lockstep lanes' changes
+ */
+static uint32_t hash_input(const uint8_t *data, size_t size)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash = (hash ^ data[i]) * 16777619u;
+    }
+
+    return hash;
+}
+
+/*
+ * Run a lockstep group of GROUP_LANES machines built from the input, and
+ * check every lane against its own chip8_cycle machine after each run.
+ * Lane 0 runs the input as given, while the hash of the input picks which
+ * other lanes change a register and a key. Between runs one lane at a time
+ * also toggles a key.
+ * Lanes therefore diverge, leave the group, run alone and regroup.
+ */
+static void check_group(const uint8_t *data, size_t size)
+{
+    static Chip8 lanes[GROUP_LANES];
+    static Chip8 references[GROUP_LANES];
+    uint32_t hash = hash_input(data, size);
+
+    Lockstep lockstep;
+    lockstep_init(&lockstep);
+    for (int l = 0; l < GROUP_LANES; l++)
+    {
+        Chip8 *machines[] = {&lanes[l], &references[l]};
+        for (int m = 0; m < 2; m++)
+        {
+            load_input(machines[m], data, size);
+            if (l > 0 && (hash >> l) & 1)
+            {
+                machines[m]->V[(hash >> (8 + l)) & 0xF] += l;
+                machines[m]->keypad[(hash >> (4 * l)) & 0xF] ^= 1;
+            }
+        }
+        lockstep_add(&lockstep, &lanes[l]);
+    }
+
+    for (int run = 0; lockstep.num_lanes > 0 && lockstep.cycles < MAX_CYCLES; run++)
+    {
+        unsigned int length = run_length(run);
+        int toggled = run % GROUP_LANES;
+        lanes[toggled].keypad[(run * 5 + hash) & 0xF] ^= 1;
+        references[toggled].keypad[(run * 5 + hash) & 0xF] ^= 1;
+
+        uint64_t start = lockstep.cycles;
+        Chip8Status status = lockstep_run(&lockstep, length);
+        for (int lane = 0; lane < lockstep.num_lanes; lane++)
+        {
+            Chip8 *chip8 = lockstep.machines[lane];
+            Chip8 *reference = &references[chip8 - lanes];
+            Chip8Status expected = run_cycles(reference, chip8->cycles - reference->cycles);
+
+            // Only the first lane to fault is reported. Others can stop on a
+            // fault in the same run and are reported by the next one, so they
+            // are compared then.
+            bool faulted = lane == lockstep.fault_lane;
+            if (lockstep.fault_lane >= 0 && !faulted)
+                continue;
+            if (faulted && expected == CHIP8_OK)
+                expected = chip8_cycle(reference);
+
+            bool finished = faulted ? chip8->cycles <= start + length : chip8->cycles == start + length;
+            if (!finished || (faulted ? status : CHIP8_OK) != expected || !same_state(reference, chip8))
+            {
+                fprintf(stderr, "Lockstep lane %d diverged in cycles %llu-%llu, last opcode 0x%04X\n",
+                        (int)(chip8 - lanes), (unsigned long long)start,
+                        (unsigned long long)(start + length), reference->current_op);
+                abort();
+            }
+        }
+
+        if (lockstep.fault_lane >= 0)
+            lockstep_remove(&lockstep, lockstep.fault_lane);
+    }
+
+    for (int l = 0; l < GROUP_LANES; l++)
+    {
+        chip8_release(&lanes[l]);
+        chip8_release(&references[l]);
+    }
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    static Chip8 machines[NUM_ENGINES];
+
+    if (size < STATE_HEADER_SIZE)
+        return 0;
+
+    for (size_t e = 0; e < NUM_ENGINES; e++)
+    {
+        load_input(&machines[e], data, size);
+    }
+
+    Chip8 *reference = &machines[0];
+    unsigned int length;
+    for (int run = 0, cycle = 0; cycle < MAX_CYCLES; run++, cycle += length)
+    {
+        length = run_length(run);
+        Chip8Status statuses[NUM_ENGINES];
+        for (size_t e = 0; e < NUM_ENGINES; e++)
+        {
+            statuses[e] = ENGINES[e](&machines[e], length);
+        }
+
+        for (size_t e = 1; e < NUM_ENGINES; e++)
+        {
+            if (statuses[e] != statuses[0] || !same_state(reference, &machines[e]))
+            {
+                fprintf(stderr, "Engine %zu diverged in cycles %d-%u, last opcode 0x%04X\n",
+                        e, cycle, cycle + length, reference->current_op);
+                abort();
+            }
+        }
+
+        // Faults must leave the machine in range for the next run
+        if (reference->SP > STACK_SIZE)
+        {
+            fprintf(stderr, "Stack pointer out of range: %u\n", reference->SP);
+            abort();
+        }
+
+        if (CHIP8_IS_FAULT(statuses[0]))
+            break;
+    }
+
+    for (size_t e = 0; e < NUM_ENGINES; e++)
+    {
+        chip8_release(&machines[e]);
+    }
+
+    check_group(data, size);
+    return 0;
+}
+
+#ifndef CHIP8_LIBFUZZER
+/*
+ * Standalone driver for AFL and for replaying crashes: reads one input from
+ * the file given on the command line, or from stdin
+ */
+int main(int argc, char *argv[])
+{
+    FILE *input = argc > 1 ? fopen(argv[1], "rb") : stdin;
+    if (input == NULL)
+    {
+        perror("Failed to open input");
+        return 1;
+    }
+
+    static uint8_t buffer[STATE_HEADER_SIZE + TOTAL_RAM];
+    size_t size = fread(buffer, 1, sizeof(buffer), input);
+    if (input != stdin)
+        fclose(input);
+
+    return LLVMFuzzerTestOneInput(buffer, size);
+}
+#endif
@@ -0,0 +1,307 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "chip8.h"
+#include "metrics.h"
+
+#define MAX_CHECKPOINTS 32
+#define MAX_ROMS 64
+
+typedef struct Job_t Job;
+
+struct Job_t
+{
+    const char *rom_filename;
+    uint64_t hashes[MAX_CHECKPOINTS];
+
+    // First fault hit by the ROM, if any
+    bool loaded;
+    Chip8Status status;
+    uint16_t fault_pc;
+    uint16_t fault_op;
+};
+
+static unsigned int checkpoints[MAX_CHECKPOINTS] = {60, 300};
+static int num_checkpoints = 2;
+
+/*
+ * Hash the framebuffer with 64-bit FNV-1a
+ */
+static uint64_t hash_screen(const Chip8 *chip8)
+{
+    const uint8_t *bytes = (const uint8_t *)chip8->screen;
+    uint64_t hash = 0xCBF29CE484222325ULL;
+
+    for (size_t i = 0; i < sizeof(chip8->screen); i++)
+    {
+        hash ^= bytes[i];
+        hash *= 0x100000001B3ULL;
+    }
+
+    return hash;
+}
+
+/*
+ * Run one ROM headless and record the screen hash at every checkpoint
+ */
+static void *run_job(void *arg)
+{
+    Job *job = arg;
+
+    Chip8 *chip8 = aligned_alloc(_Alignof(Chip8), sizeof(Chip8));
+    if (chip8 == NULL)
+    {
+        perror("Failed to allocate emulator");
+        exit(EXIT_FAILURE);
+    }
+
+    chip8_init(chip8);
+    job->status = CHIP8_OK;
+    job->loaded = chip8_load_rom(chip8, job->rom_filename);
+    if (!job->loaded)
+    {
+        chip8_release(chip8);
+        free(chip8);
+        return NULL;
+    }
+
+    unsigned int frame = 0;
+    for (int c = 0; c < num_checkpoints; c++)
+    {
+        for (; frame < checkpoints[c] && job->status == CHIP8_OK; frame++)
+        {
+            Chip8Status status = chip8_run(chip8, chip8->cycles_per_frame, CHIP8_STOP_ON(CHIP8_FRAME));
+            if (CHIP8_IS_FAULT(status))
+            {
+                job->status = status;
+                job->fault_pc = chip8->fault_pc;
+                job->fault_op = chip8->current_op;
+            }
+        }
+
+        job->hashes[c] = hash_screen(chip8);
+    }
+
+    metrics_flush();
+    chip8_release(chip8);
+    free(chip8);
+    return NULL;
+}
+
+/*
+ * Name a ROM by its file name alone, so a manifest works from any directory
+ */
+static const char *rom_name(const char *rom_filename)
+{
+    const char *slash = strrchr(rom_filename, '/');
+    return slash ? slash + 1 : rom_filename;
+}
+
+/*
+ * Parse a comma separated, ascending list of frame numbers
+ */
+static bool parse_checkpoints(const char *list)
+{
+    num_checkpoints = 0;
+
+    while (*list != '\0')
+    {
+        char *endptr;
+        unsigned long frame = strtoul(list, &endptr, 10);
+        if (endptr == list || num_checkpoints == MAX_CHECKPOINTS ||
+            (num_checkpoints > 0 && frame <= checkpoints[num_checkpoints - 1]))
+            return false;
+
+        checkpoints[num_checkpoints++] = frame;
+
+        if (*endptr == ',')
+            endptr++;
+        else if (*endptr != '\0')
+            return false;
+        list = endptr;
+    }
+
+    return num_checkpoints > 0;
+}
+
+/*
+ * Compare the computed hashes against a manifest of "<frame> <hash> <rom>" lines,
+ * where rom is the file name without its directory. Entries for ROMs or frames
+ * that were not run, and checkpoints of a ROM with no entry, count as missing.
+ * Returns the number of mismatched or missing entries.
+ */
+static int check_manifest(const char *manifest_filename, const Job *jobs, int num_jobs)
+{
+    FILE *manifest = fopen(manifest_filename, "r");
+    if (manifest == NULL)
+    {
+        perror("Failed to open manifest");
+        return -1;
+    }
+
+    static bool matched[MAX_ROMS][MAX_CHECKPOINTS];
+    memset(matched, 0, sizeof(matched));
+
+    int failures = 0;
+    char line[512];
+    while (fgets(line, sizeof(line), manifest))
+    {
+        char rom[400];
+        unsigned int frame;
+        unsigned long long expected;
+
+        if (line[0] == '#' || sscanf(line, "%u %llx %399[^\n]", &frame, &expected, rom) != 3)
+            continue;
+
+        bool found = false;
+        for (int j = 0; j < num_jobs && !found; j++)
+        {
+            if (strcmp(rom, rom_name(jobs[j].rom_filename)) != 0)
+                continue;
+
+            for (int c = 0; c < num_checkpoints; c++)
+            {
+                if (checkpoints[c] != frame)
+                    continue;
+
+                found = true;
+                matched[j][c] = true;
+                if (jobs[j].hashes[c] != expected)
+                {
+                    printf("MISMATCH %s frame %u: expected %016llx, got %016llx\n",
+                           rom, frame, expected, (unsigned long long)jobs[j].hashes[c]);
+                    failures++;
+                }
+            }
+        }
+
+        if (!found)
+        {
+            printf("MISSING %s frame %u\n", rom, frame);
+            failures++;
+        }
+    }
+
+    fclose(manifest);
+
+    for (int j = 0; j < num_jobs; j++)
+    {
+        for (int c = 0; c < num_checkpoints; c++)
+        {
+            if (!matched[j][c])
+            {
+                printf("MISSING %s frame %u: no manifest entry\n", rom_name(jobs[j].rom_filename),
+                       checkpoints[c]);
+                failures++;
+            }
+        }
+    }
+
+    return failures;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *manifest_filename = NULL;
+    const char *metrics_filename = NULL;
+    Job jobs[MAX_ROMS];
+    int num_jobs = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+        {
+            if (!parse_checkpoints(argv[++i]))
+            {
+                printf("Invalid frame list: %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--check") == 0 && i + 1 < argc)
+        {
+            manifest_filename = argv[++i];
+        }
+        else if (strcmp(argv[i], "--metrics") == 0)
+        {
+            if (i + 1 >= argc || !metrics_init(argv[++i]))
+            {
+                printf("Invalid option: --metrics\n");
+                return 1;
+            }
+            metrics_filename = argv[i];
+        }
+        else if (num_jobs < MAX_ROMS)
+        {
+            jobs[num_jobs++].rom_filename = argv[i];
+        }
+        else
+        {
+            printf("Too many ROMs, at most %d can be run at once\n", MAX_ROMS);
+            return 1;
+        }
+    }
+
+    if (num_jobs == 0)
+    {
+        printf("Usage: %s [--frames n,m,...] [--check <manifest>] [--metrics <file>] <rom>...\n",
+               argv[0]);
+        return 1;
+    }
+
+    // Every ROM is independent, so run each one on its own thread
+    pthread_t threads[MAX_ROMS];
+    for (int j = 0; j < num_jobs; j++)
+    {
+        pthread_create(&threads[j], NULL, run_job, &jobs[j]);
+    }
+    for (int j = 0; j < num_jobs; j++)
+    {
+        pthread_join(threads[j], NULL);
+    }
+
+    if (metrics_filename)
+        metrics_write_file(metrics_filename);
+
+    // A faulting ROM keeps its last frame, but the fault is reported and fails the run
+    int faults = 0;
+    for (int j = 0; j < num_jobs; j++)
+    {
+        if (!jobs[j].loaded)
+        {
+            fprintf(stderr, "%s: failed to load\n", jobs[j].rom_filename);
+            faults++;
+            continue;
+        }
+
+        if (jobs[j].status == CHIP8_OK)
+            continue;
+
+        fprintf(stderr, "%s: %s at 0x%03X (opcode 0x%04X)\n", jobs[j].rom_filename,
+                chip8_status_string(jobs[j].status), jobs[j].fault_pc, jobs[j].fault_op);
+        faults++;
+    }
+
+    if (manifest_filename)
+    {
+        int failures = check_manifest(manifest_filename, jobs, num_jobs);
+        if (failures != 0 || faults != 0)
+            return 1;
+
+        printf("All frames match %s\n", manifest_filename);
+        return 0;
+    }
+
+    // Without a manifest, print one in the format --check expects
+    for (int j = 0; j < num_jobs; j++)
+    {
+        for (int c = 0; c < num_checkpoints; c++)
+        {
+            printf("%u %016llx %s\n", checkpoints[c],
+                   (unsigned long long)jobs[j].hashes[c], rom_name(jobs[j].rom_filename));
+        }
+    }
+
+    return faults != 0;
+}
@@ -0,0 +1,423 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "server.h"
+
+#define MAX_EVENTS 64
+
+typedef struct Session_t Session;
+
+struct Session_t
+{
+    int socket;
+    int ring_fd;
+    ServerFrame *ring;
+    uint64_t sequence;
+
+    // Reply that could not be sent yet; no request is read until it goes out
+    bool reply_pending;
+    ServerReply reply;
+
+    Chip8 *chip8;
+    Chip8 *snapshots[SERVER_MAX_SNAPSHOTS];
+};
+
+static Chip8Image image;
+static uint32_t seed = 1;
+
+/*
+ * Put a session's machine back into its power-on state with the ROM attached
+ */
+static void reset_machine(Session *session, uint32_t new_seed)
+{
+    chip8_release(session->chip8);
+    chip8_init(session->chip8);
+    chip8_attach_image(session->chip8, &image);
+    chip8_seed(session->chip8, new_seed != 0 ? new_seed : seed);
+}
+
+static void close_session(Session *session)
+{
+    close(session->socket);
+    munmap(session->ring, SERVER_RING_SLOTS * sizeof(ServerFrame));
+    close(session->ring_fd);
+
+    for (int s = 0; s < SERVER_MAX_SNAPSHOTS; s++)
+    {
+        if (session->snapshots[s] == NULL)
+            continue;
+        chip8_release(session->snapshots[s]);
+        free(session->snapshots[s]);
+    }
+
+    chip8_release(session->chip8);
+    free(session->chip8);
+    free(session);
+}
+
+/*
+ * Create a session for a new connection and send it the frame ring.
+ * Returns NULL, with the socket closed, on failure.
+ */
+static Session *open_session(int socket)
+{
+    Session *session = calloc(1, sizeof(Session));
+    if (session == NULL)
+    {
+        close(socket);
+        return NULL;
+    }
+
+    session->socket = socket;
+    session->ring_fd = memfd_create("chip8-frames", MFD_CLOEXEC);
+    session->ring = MAP_FAILED;
+    session->chip8 = aligned_alloc(_Alignof(Chip8), sizeof(Chip8));
+
+    size_t ring_size = SERVER_RING_SLOTS * sizeof(ServerFrame);
+    if (session->ring_fd < 0 || session->chip8 == NULL || ftruncate(session->ring_fd, ring_size) < 0)
+        goto fail;
+
+    session->ring = mmap(NULL, ring_size, PROT_READ | PROT_WRITE, MAP_SHARED, session->ring_fd, 0);
+    if (session->ring == MAP_FAILED)
+        goto fail;
+
+    chip8_init(session->chip8);
+    reset_machine(session, 0);
+
+    // The ring is handed over with the hello so frames never go through the socket
+    ServerHello hello = {SERVER_RING_SLOTS, sizeof(ServerFrame), SCREEN_WIDTH, SCREEN_HEIGHT};
+    struct iovec iov = {&hello, sizeof(hello)};
+    union
+    {
+        char buffer[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    struct msghdr message = {0};
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control.buffer;
+    message.msg_controllen = sizeof(control.buffer);
+
+    struct cmsghdr *header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(header), &session->ring_fd, sizeof(int));
+
+    if (sendmsg(socket, &message, MSG_NOSIGNAL) != sizeof(hello))
+        goto fail;
+
+    return session;
+
+fail:
+    perror("Failed to open session");
+    if (session->ring != MAP_FAILED)
+        munmap(session->ring, ring_size);
+    if (session->ring_fd >= 0)
+        close(session->ring_fd);
+    free(session->chip8);
+    free(session);
+    close(socket);
+    return NULL;
+}
+
+/*
+ * Write the screen into the next ring slot and note it in the reply.
+ * The slot's sequence is odd while the pixels are being written.
+ */
+static void publish_frame(Session *session, ServerReply *reply)
+{
+    uint16_t slot = (session->sequence / 2) % SERVER_RING_SLOTS;
+    ServerFrame *frame = &session->ring[slot];
+
+    // The fence keeps the pixel stores from being seen before the odd sequence
+    __atomic_store_n(&frame->sequence, session->sequence + 1, __ATOMIC_RELEASE);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    for (int y = 0; y < SCREEN_HEIGHT; y++)
+    {
+        for (int x = 0; x < SCREEN_WIDTH; x++)
+        {
+            frame->pixels[y][x] = session->chip8->screen[y * SCREEN_WIDTH + x] != 0;
+        }
+    }
+
+    session->sequence += 2;
+    __atomic_store_n(&frame->sequence, session->sequence, __ATOMIC_RELEASE);
+
+    reply->slot = slot;
+    reply->sequence = session->sequence;
+}
+
+/*
+ * Run the given number of frames with the keys held, stopping early on a fault.
+ * At most SERVER_MAX_STEP_FRAMES are run; the reply says how many were, and a
+ * client wanting more sends another step. A faulted machine faults again
+ * straight away until it is reset or restored.
+ */
+static Chip8Status step(Session *session, uint16_t keys, uint32_t frames, ServerReply *reply)
+{
+    Chip8 *chip8 = session->chip8;
+    Chip8Status status = CHIP8_OK;
+
+    for (int k = 0; k < NUM_KEYS; k++)
+    {
+        chip8->keypad[k] = (keys >> k) & 1;
+    }
+
+    if (frames > SERVER_MAX_STEP_FRAMES)
+        frames = SERVER_MAX_STEP_FRAMES;
+
+    for (reply->frames = 0; reply->frames < frames; reply->frames++)
+    {
+        status = chip8_run(chip8, chip8->cycles_per_frame, CHIP8_STOP_ON(CHIP8_FRAME));
+        if (CHIP8_IS_FAULT(status))
+            break;
+    }
+
+    return status;
+}
+
+/*
+ * Save a copy of the machine, sharing every page it has not written
+ */
+static ServerError snapshot(Session *session, uint32_t index)
+{
+    if (index >= SERVER_MAX_SNAPSHOTS)
+        return SERVER_ERROR_BAD_REQUEST;
+
+    Chip8 **slot = &session->snapshots[index];
+    if (*slot == NULL)
+    {
+        *slot = aligned_alloc(_Alignof(Chip8), sizeof(Chip8));
+        if (*slot == NULL)
+            return SERVER_ERROR_OUT_OF_MEMORY;
+        chip8_init(*slot);
+    }
+
+    chip8_release(*slot);
+    return chip8_clone(*slot, session->chip8) ? SERVER_ERROR_NONE : SERVER_ERROR_OUT_OF_MEMORY;
+}
+
+static ServerError restore(Session *session, uint32_t index)
+{
+    if (index >= SERVER_MAX_SNAPSHOTS)
+        return SERVER_ERROR_BAD_REQUEST;
+    if (session->snapshots[index] == NULL)
+        return SERVER_ERROR_NO_SNAPSHOT;
+
+    chip8_release(session->chip8);
+    return chip8_clone(session->chip8, session->snapshots[index]) ? SERVER_ERROR_NONE
+                                                                 : SERVER_ERROR_OUT_OF_MEMORY;
+}
+
+static ServerReply handle_request(Session *session, const ServerRequest *request)
+{
+    ServerReply reply = {0};
+    reply.status = CHIP8_OK;
+
+    switch (request->command)
+    {
+    case SERVER_RESET:
+        reset_machine(session, request->argument);
+        publish_frame(session, &reply);
+        break;
+
+    case SERVER_STEP:
+        reply.status = step(session, request->keys, request->argument, &reply);
+        publish_frame(session, &reply);
+        break;
+
+    case SERVER_GET_FRAME:
+        publish_frame(session, &reply);
+        break;
+
+    case SERVER_SNAPSHOT:
+        reply.error = snapshot(session, request->argument);
+        break;
+
+    case SERVER_RESTORE:
+        reply.error = restore(session, request->argument);
+        break;
+
+    default:
+        reply.error = SERVER_ERROR_BAD_REQUEST;
+        break;
+    }
+
+    reply.cycles = session->chip8->cycles;
+    return reply;
+}
+
+/*
+ * Send the pending reply. Returns false if the client has gone away.
+ */
+static bool flush_reply(int epoll_fd, Session *session)
+{
+    ssize_t sent = send(session->socket, &session->reply, sizeof(ServerReply), MSG_NOSIGNAL);
+    if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+    {
+        // Stop reading requests until the client drains its replies
+        if (!session->reply_pending)
+        {
+            struct epoll_event event = {.events = EPOLLOUT, .data.ptr = session};
+            epoll_ctl(epoll_fd, EPOLL_CTL_MOD, session->socket, &event);
+        }
+        session->reply_pending = true;
+        return true;
+    }
+
+    if (sent != sizeof(ServerReply))
+        return false;
+
+    if (session->reply_pending)
+    {
+        struct epoll_event event = {.events = EPOLLIN, .data.ptr = session};
+        epoll_ctl(epoll_fd, EPOLL_CTL_MOD, session->socket, &event);
+    }
+    session->reply_pending = false;
+    return true;
+}
+
+/*
+ * Handle every request waiting on a session. Returns false once the
+ * connection is closed or the client breaks the protocol.
+ */
+static bool serve(int epoll_fd, Session *session)
+{
+    if (session->reply_pending)
+        return flush_reply(epoll_fd, session);
+
+    while (true)
+    {
+        ServerRequest request;
+        ssize_t received = recv(session->socket, &request, sizeof(request), MSG_DONTWAIT);
+        if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return true;
+        if (received != sizeof(request))
+            return false;
+
+        session->reply = handle_request(session, &request);
+        if (!flush_reply(epoll_fd, session))
+            return false;
+        if (session->reply_pending)
+            return true;
+    }
+}
+
+static int listen_on(const char *path)
+{
+    struct sockaddr_un address = {.sun_family = AF_UNIX};
+    if (strlen(path) >= sizeof(address.sun_path))
+    {
+        printf("Socket path is too long: %s\n", path);
+        return -1;
+    }
+    strcpy(address.sun_path, path);
+
+    int listener = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listener < 0)
+    {
+        perror("Failed to create socket");
+        return -1;
+    }
+
+    unlink(path);
+    if (bind(listener, (struct sockaddr *)&address, sizeof(address)) < 0 ||
+        listen(listener, SOMAXCONN) < 0)
+    {
+        perror("Failed to listen on socket");
+        close(listener);
+        return -1;
+    }
+
+    return listener;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3)
+    {
+        printf("Usage: %s <socket> <rom> [--seed n]\n", argv[0]);
+        return 1;
+    }
+
+    for (int i = 3; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+            seed = strtoul(argv[++i], NULL, 0);
+    }
+
+    // Every session shares the ROM's pages until it writes to them
+    chip8_image_init(&image);
+    if (!chip8_image_load_rom(&image, argv[2]))
+        return 1;
+
+    int listener = listen_on(argv[1]);
+    if (listener < 0)
+        return 1;
+
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event event = {.events = EPOLLIN, .data.ptr = NULL};
+    if (epoll_fd < 0 || epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listener, &event) < 0)
+    {
+        perror("Failed to set up epoll");
+        return 1;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    printf("Serving %s on %s\n", argv[2], argv[1]);
+
+    struct epoll_event events[MAX_EVENTS];
+    while (true)
+    {
+        int num_events = epoll_wait(epoll_fd, events, MAX_EVENTS, -1);
+        if (num_events < 0 && errno != EINTR)
+        {
+            perror("epoll_wait failed");
+            break;
+        }
+
+        for (int e = 0; e < num_events; e++)
+        {
+            Session *session = events[e].data.ptr;
+
+            // The listener is the only descriptor registered without a session
+            if (session == NULL)
+            {
+                int client;
+                while ((client = accept4(listener, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0)
+                {
+                    Session *opened = open_session(client);
+                    if (opened == NULL)
+                        continue;
+
+                    struct epoll_event client_event = {.events = EPOLLIN, .data.ptr = opened};
+                    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, client, &client_event);
+                }
+                continue;
+            }
+
+            if ((events[e].events & (EPOLLHUP | EPOLLERR)) || !serve(epoll_fd, session))
+            {
+                epoll_ctl(epoll_fd, EPOLL_CTL_DEL, session->socket, NULL);
+                close_session(session);
+            }
+        }
+    }
+
+    close(epoll_fd);
+    close(listener);
+    unlink(argv[1]);
+    return 1;
+}
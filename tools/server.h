@@ -0,0 +1,87 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <stdint.h>
+
+#include "chip8.h"
+
+/*
+ * Wire protocol of chip8-server. Clients connect to a SOCK_SEQPACKET Unix
+ * socket, so every request and reply is exactly one message. All fields are
+ * in host byte order.
+ *
+ * On connect the server sends a ServerHello carrying a memfd (SCM_RIGHTS)
+ * that the client maps read-only. It holds SERVER_RING_SLOTS ServerFrames.
+ * Replies that publish a frame name the slot it was written to; a slot is
+ * only reused SERVER_RING_SLOTS frames later.
+ */
+
+#define SERVER_RING_SLOTS 8
+#define SERVER_MAX_SNAPSHOTS 4
+
+// Most frames one SERVER_STEP runs, so a session cannot hold up the others
+#define SERVER_MAX_STEP_FRAMES 600
+
+typedef enum ServerCommand_t
+{
+    SERVER_RESET,     // Restart the ROM; argument is the RNG seed, 0 keeps the default
+    SERVER_STEP,      // Hold keys for argument frames, at most SERVER_MAX_STEP_FRAMES, then publish the frame
+    SERVER_GET_FRAME, // Publish the current frame
+    SERVER_SNAPSHOT,  // Save the machine into snapshot slot argument
+    SERVER_RESTORE,   // Load the machine from snapshot slot argument
+} ServerCommand;
+
+typedef enum ServerError_t
+{
+    SERVER_ERROR_NONE,
+    SERVER_ERROR_BAD_REQUEST,
+    SERVER_ERROR_NO_SNAPSHOT,
+    SERVER_ERROR_OUT_OF_MEMORY,
+} ServerError;
+
+typedef struct ServerHello_t ServerHello;
+typedef struct ServerRequest_t ServerRequest;
+typedef struct ServerReply_t ServerReply;
+typedef struct ServerFrame_t ServerFrame;
+
+struct ServerHello_t
+{
+    uint32_t ring_slots;
+    uint32_t frame_size; // sizeof(ServerFrame)
+    uint16_t width;
+    uint16_t height;
+};
+
+struct ServerRequest_t
+{
+    uint8_t command;
+    uint8_t reserved;
+    uint16_t keys; // Bit n holds key n down during SERVER_STEP
+    uint32_t argument;
+};
+
+struct ServerReply_t
+{
+    uint8_t error;  // ServerError
+    uint8_t status; // Chip8Status that ended the request
+    uint16_t slot;  // Ring slot holding the published frame
+    uint32_t frames; // Frames actually run by SERVER_STEP
+    uint64_t sequence; // Sequence of the published frame, twice the number published so far
+    uint64_t cycles;
+};
+
+/*
+ * One published frame, a byte per pixel. sequence is a seqlock: it is odd
+ * while the server is writing the slot and even once the frame is complete.
+ * To read the frame named by a reply, load sequence with acquire ordering,
+ * copy the pixels, then load it again after an acquire fence. The copy is
+ * only good if both loads equal the reply's sequence; if either is odd or
+ * different, the slot has been reused and the client should fetch again.
+ */
+struct ServerFrame_t
+{
+    uint8_t pixels[SCREEN_HEIGHT][SCREEN_WIDTH];
+    uint64_t sequence;
+};
+
+#endif // SERVER_H
@@ -0,0 +1,107 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "chip8.h"
+#include "disassembler.h"
+#include "trace.h"
+
+/*
+ * Whether an instruction writes Vx, so the recorded Vx is worth showing
+ */
+static bool writes_vx(uint16_t opcode)
+{
+    switch (opcode & 0xF000)
+    {
+    case 0x6000:
+    case 0x7000:
+    case 0x8000:
+    case 0xC000:
+        return true;
+    case 0xF000:
+        return (opcode & 0x00FF) == 0x07 || (opcode & 0x00FF) == 0x0A || (opcode & 0x00FF) == 0x65;
+    default:
+        return false;
+    }
+}
+
+/*
+ * Print one instruction, numbered from the start of tracing, with the state
+ * that changed since the one before it
+ */
+static void print_entry(uint64_t number, const TraceEntry *entry, const TraceEntry *previous)
+{
+    char text[DISASM_MAX_LENGTH];
+    chip8_disassemble(entry->opcode, text, sizeof(text));
+    printf("%10llu  0x%03X  %04X  %-16s", (unsigned long long)number, entry->pc & RAM_MASK,
+           entry->opcode, text);
+
+    unsigned int x = (entry->opcode & 0x0F00) >> 8;
+    if (writes_vx(entry->opcode) && x != 0xF)
+        printf(" V%X=%02X", x, entry->registers & 0xFF);
+    if (previous == NULL || (entry->registers >> 8) != (previous->registers >> 8))
+        printf(" VF=%02X", entry->registers >> 8);
+    if (previous == NULL || entry->I != previous->I)
+        printf(" I=%03X", entry->I);
+
+    printf("\n");
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned long last = 0;
+    if (argc == 4 && strcmp(argv[2], "--last") == 0)
+    {
+        last = strtoul(argv[3], NULL, 10);
+    }
+    else if (argc != 2)
+    {
+        printf("Usage: %s <trace> [--last <n>]\n", argv[0]);
+        return 1;
+    }
+
+    FILE *file = fopen(argv[1], "rb");
+    if (file == NULL)
+    {
+        perror("Failed to open trace");
+        return 1;
+    }
+
+    TraceHeader header;
+    if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, TRACE_MAGIC, 8) != 0 ||
+        header.version != TRACE_VERSION)
+    {
+        printf("Not a trace file: %s\n", argv[1]);
+        fclose(file);
+        return 1;
+    }
+
+    TraceEntry *entries = malloc((size_t)header.num_entries * sizeof(TraceEntry));
+    if (entries == NULL && header.num_entries > 0)
+    {
+        perror("Failed to allocate trace");
+        fclose(file);
+        return 1;
+    }
+
+    size_t count = fread(entries, sizeof(TraceEntry), header.num_entries, file);
+    fclose(file);
+    if (count != header.num_entries)
+        printf("Trace is truncated: %zu of %u entries\n", count, header.num_entries);
+
+    printf("%llu instructions recorded, last %zu kept\n", (unsigned long long)header.total, count);
+
+    size_t first = last > 0 && last < count ? count - last : 0;
+    uint64_t number = header.total - header.num_entries;
+    printf("%10s  %-5s  %-4s  %-16s %s\n", "cycle", "PC", "op", "instruction", "state");
+    for (size_t i = first; i < count; i++)
+    {
+        print_entry(number + i, &entries[i], i > first ? &entries[i - 1] : NULL);
+    }
+
+    if (header.status != CHIP8_OK)
+        printf("Stopped by %s\n", chip8_status_string(header.status));
+
+    free(entries);
+    return 0;
+}